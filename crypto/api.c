@@ -16,6 +16,7 @@
 #include <linux/kmod.h>
 #include <linux/module.h>
 #include <linux/param.h>
+#include <linux/percpu.h>
 #include <linux/sched/signal.h>
 #include <linux/slab.h>
 #include <linux/string.h>
@@ -607,5 +608,94 @@ void crypto_req_done(struct crypto_async_request *req, int err)
 }
 EXPORT_SYMBOL_GPL(crypto_req_done);
 
+/*
+ *	crypto_req_cache_init - Set up a per-CPU request cache
+ *	@cache: Cache to initialise
+ *	@size: Size of the cached buffers
+ *
+ *	Every possible CPU starts out with a spare buffer, so the first
+ *	request on each CPU does not allocate either.
+ */
+int crypto_req_cache_init(struct crypto_req_cache *cache, unsigned int size)
+{
+	int cpu;
+
+	cache->size = size;
+	cache->spare = alloc_percpu(void *);
+	if (!cache->spare)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		void *req = kmalloc_node(size, GFP_KERNEL, cpu_to_node(cpu));
+
+		if (!req) {
+			crypto_req_cache_destroy(cache);
+			return -ENOMEM;
+		}
+		*per_cpu_ptr(cache->spare, cpu) = req;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(crypto_req_cache_init);
+
+void crypto_req_cache_destroy(struct crypto_req_cache *cache)
+{
+	int cpu;
+
+	if (!cache->spare)
+		return;
+
+	for_each_possible_cpu(cpu)
+		kzfree(*per_cpu_ptr(cache->spare, cpu));
+	free_percpu(cache->spare);
+	cache->spare = NULL;
+}
+EXPORT_SYMBOL_GPL(crypto_req_cache_destroy);
+
+/* Take this CPU's spare buffer, if it has one */
+void *crypto_req_cache_get(struct crypto_req_cache *cache)
+{
+	return this_cpu_xchg(*cache->spare, NULL);
+}
+EXPORT_SYMBOL_GPL(crypto_req_cache_get);
+
+/*
+ * Offer @req, which must be at least cache->size bytes, as this CPU's
+ * spare buffer. Returns false if the CPU already has one, in which case
+ * the caller still owns @req.
+ */
+bool crypto_req_cache_put(struct crypto_req_cache *cache, void *req)
+{
+	return this_cpu_cmpxchg(*cache->spare, NULL, req) == NULL;
+}
+EXPORT_SYMBOL_GPL(crypto_req_cache_put);
+
+void *crypto_req_cache_alloc(struct crypto_req_cache *cache, unsigned int len,
+			     gfp_t gfp)
+{
+	void *req;
+
+	if (len > cache->size)
+		return kmalloc(len, gfp);
+
+	req = crypto_req_cache_get(cache);
+	if (req)
+		return req;
+
+	return kmalloc(cache->size, gfp);
+}
+EXPORT_SYMBOL_GPL(crypto_req_cache_alloc);
+
+/* Free a buffer from crypto_req_cache_alloc(), possibly on another CPU */
+void crypto_req_cache_free(struct crypto_req_cache *cache, void *req)
+{
+	if (req && ksize(req) >= cache->size && crypto_req_cache_put(cache, req))
+		return;
+
+	kfree(req);
+}
+EXPORT_SYMBOL_GPL(crypto_req_cache_free);
+
 MODULE_DESCRIPTION("Cryptographic core API");
 MODULE_LICENSE("GPL");
@@ -117,6 +117,22 @@ static int crypto_scomp_init_tfm(struct crypto_tfm *tfm)
 	return ret;
 }
 
+/*
+ * Return a kernel virtual address for the first @len bytes of @sg if they
+ * sit in a single lowmem entry, so the caller can skip the scratch copy.
+ * This is the common case for page sized requests such as those from zswap.
+ */
+static void *scomp_sg_linear(struct scatterlist *sg, unsigned int len)
+{
+	if (!sg || sg->length < len)
+		return NULL;
+
+	if (PageHighMem(sg_page(sg)))
+		return NULL;
+
+	return sg_virt(sg);
+}
+
 static int scomp_acomp_comp_decomp(struct acomp_req *req, int dir)
 {
 	struct crypto_acomp *tfm = crypto_acomp_reqtfm(req);
@@ -124,6 +140,7 @@ static int scomp_acomp_comp_decomp(struct acomp_req *req, int dir)
 	struct crypto_scomp *scomp = *tfm_ctx;
 	void **ctx = acomp_request_ctx(req);
 	struct scomp_scratch *scratch;
+	void *src, *dst;
 	int ret;
 
 	if (!req->src || !req->slen || req->slen > SCOMP_SCRATCH_SIZE)
@@ -135,15 +152,32 @@ static int scomp_acomp_comp_decomp(struct acomp_req *req, int dir)
 	if (!req->dlen || req->dlen > SCOMP_SCRATCH_SIZE)
 		req->dlen = SCOMP_SCRATCH_SIZE;
 
+	src = scomp_sg_linear(req->src, req->slen);
+
+	/*
+	 * Decompressors never write past dlen, so a linear destination can be
+	 * used directly. Some compressors assume a worst case sized output
+	 * buffer, hence compression always goes through the scratch buffer.
+	 */
+	dst = dir ? NULL : scomp_sg_linear(req->dst, req->dlen);
+
+	if (src && dst)
+		return crypto_scomp_decompress(scomp, src, req->slen,
+					       dst, &req->dlen, *ctx);
+
 	scratch = raw_cpu_ptr(&scomp_scratch);
 	spin_lock(&scratch->lock);
 
-	scatterwalk_map_and_copy(scratch->src, req->src, 0, req->slen, 0);
+	if (!src) {
+		scatterwalk_map_and_copy(scratch->src, req->src, 0,
+					 req->slen, 0);
+		src = scratch->src;
+	}
 	if (dir)
-		ret = crypto_scomp_compress(scomp, scratch->src, req->slen,
+		ret = crypto_scomp_compress(scomp, src, req->slen,
 					    scratch->dst, &req->dlen, *ctx);
 	else
-		ret = crypto_scomp_decompress(scomp, scratch->src, req->slen,
+		ret = crypto_scomp_decompress(scomp, src, req->slen,
 					      scratch->dst, &req->dlen, *ctx);
 	if (!ret) {
 		if (!req->dst) {
@@ -20,6 +20,7 @@
 #define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
 
 #include <crypto/aead.h>
+#include <crypto/authenc.h>
 #include <crypto/hash.h>
 #include <crypto/skcipher.h>
 #include <linux/err.h>
@@ -33,6 +34,11 @@
 #include <linux/jiffies.h>
 #include <linux/timex.h>
 #include <linux/interrupt.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/rtnetlink.h>
+#include <linux/sort.h>
 #include "tcrypt.h"
 
 /*
@@ -1632,6 +1638,511 @@ static void test_cipher_speed(const char *algo, int enc, unsigned int secs,
 				   false);
 }
 
+#define COMP_DST_SIZE	(2 * PAGE_SIZE)
+
+static int do_one_comp_op(struct crypto_comp *tfm, bool compress,
+			  const u8 *src, unsigned int slen, u8 *dst,
+			  unsigned int *dlen)
+{
+	*dlen = compress ? COMP_DST_SIZE : PAGE_SIZE;
+
+	if (compress)
+		return crypto_comp_compress(tfm, src, slen, dst, dlen);
+
+	return crypto_comp_decompress(tfm, src, slen, dst, dlen);
+}
+
+static int test_comp_jiffies(struct crypto_comp *tfm, bool compress,
+			     const u8 *src, unsigned int slen, u8 *dst, int secs)
+{
+	unsigned long start, end;
+	unsigned int dlen;
+	int bcount;
+	int ret;
+
+	for (start = jiffies, end = start + secs * HZ, bcount = 0;
+	     time_before(jiffies, end); bcount++) {
+		ret = do_one_comp_op(tfm, compress, src, slen, dst, &dlen);
+		if (ret)
+			return ret;
+	}
+
+	pr_cont("%6u opers/sec, %9lu bytes/sec\n",
+		bcount / secs, ((long)bcount * PAGE_SIZE) / secs);
+
+	return 0;
+}
+
+static int test_comp_cycles(struct crypto_comp *tfm, bool compress,
+			    const u8 *src, unsigned int slen, u8 *dst)
+{
+	unsigned long cycles = 0;
+	unsigned int dlen;
+	int ret = 0;
+	int i;
+
+	/* Warm-up run. */
+	for (i = 0; i < 4; i++) {
+		ret = do_one_comp_op(tfm, compress, src, slen, dst, &dlen);
+		if (ret)
+			goto out;
+	}
+
+	/* The real thing. */
+	for (i = 0; i < 8; i++) {
+		cycles_t start, end;
+
+		start = get_cycles();
+		ret = do_one_comp_op(tfm, compress, src, slen, dst, &dlen);
+		end = get_cycles();
+
+		if (ret)
+			goto out;
+
+		cycles += end - start;
+	}
+
+out:
+	if (ret)
+		return ret;
+
+	pr_cont("%6lu cycles/operation, %4lu cycles/byte\n",
+		cycles / 8, cycles / (8 * PAGE_SIZE));
+
+	return 0;
+}
+
+/*
+ * Compress and decompress a single page, which is what zswap and zram do.
+ * The input is a text like mix of words, so that it is compressible but
+ * not trivially so.
+ */
+static void test_comp_speed(const char *algo, unsigned int secs)
+{
+	static const char * const words[] = {
+		"swap ", "page ", "reclaim ", "zram ", "anon ", "lru ",
+		"kswapd ", "vma ",
+	};
+	struct crypto_comp *tfm;
+	unsigned int clen, dlen;
+	u8 *src, *cbuf, *dbuf;
+	unsigned int i, n;
+	int ret;
+
+	tfm = crypto_alloc_comp(algo, 0, 0);
+	if (IS_ERR(tfm)) {
+		pr_err("failed to load transform for %s: %ld\n", algo,
+		       PTR_ERR(tfm));
+		return;
+	}
+
+	src = tvmem[0];
+	dbuf = tvmem[1];
+	cbuf = kmalloc(COMP_DST_SIZE, GFP_KERNEL);
+	if (!cbuf)
+		goto out_free_tfm;
+
+	for (i = 0, n = 0; i < PAGE_SIZE; n++) {
+		const char *w = words[(n * 7 + (n >> 3)) % ARRAY_SIZE(words)];
+
+		while (*w && i < PAGE_SIZE)
+			src[i++] = *w++;
+	}
+
+	ret = do_one_comp_op(tfm, true, src, PAGE_SIZE, cbuf, &clen);
+	if (!ret)
+		ret = do_one_comp_op(tfm, false, cbuf, clen, dbuf, &dlen);
+	if (ret || dlen != PAGE_SIZE || memcmp(src, dbuf, PAGE_SIZE)) {
+		pr_err("%s: round trip of a page failed: %d\n", algo, ret);
+		goto out_free;
+	}
+
+	pr_info("\ntesting speed of %s (%s), %lu byte pages compressed to %u bytes\n",
+		algo, get_driver_name(crypto_comp, tfm), PAGE_SIZE, clen);
+
+	pr_info("compress:   ");
+	if (secs)
+		ret = test_comp_jiffies(tfm, true, src, PAGE_SIZE, cbuf,
+					secs);
+	else
+		ret = test_comp_cycles(tfm, true, src, PAGE_SIZE, cbuf);
+	if (ret) {
+		pr_err("compress failed: %d\n", ret);
+		goto out_free;
+	}
+
+	pr_info("decompress: ");
+	if (secs)
+		ret = test_comp_jiffies(tfm, false, cbuf, clen, dbuf, secs);
+	else
+		ret = test_comp_cycles(tfm, false, cbuf, clen, dbuf);
+	if (ret)
+		pr_err("decompress failed: %d\n", ret);
+
+out_free:
+	kfree(cbuf);
+out_free_tfm:
+	crypto_free_comp(tfm);
+}
+
+/*
+ * Benchmark modes (800 to 804) for comparing implementations and kernels.
+ * alg= names the algorithm or driver and type=/mask= are used when
+ * allocating it, e.g. mask=0x80 only considers synchronous implementations.
+ * num_mb= requests are kept in flight at once and each size in sizes= is
+ * measured over iters= rounds of them. One line of key=value pairs is
+ * printed per size.
+ */
+#define BENCH_MAX_SIZE		65536
+#define BENCH_MAX_SIZES		16
+#define BENCH_AUTHKEY_LEN	32
+
+enum bench_kind {
+	BENCH_AHASH,
+	BENCH_SKCIPHER,
+	BENCH_AEAD,
+};
+
+static unsigned int bench_sizes[BENCH_MAX_SIZES];
+static int bench_num_sizes;
+static unsigned int bench_iters = 1024;
+static unsigned int bench_klen;
+
+struct bench_data {
+	void *req;
+	struct crypto_wait wait;
+	struct scatterlist src;
+	struct scatterlist dst;
+	u8 *in;
+	u8 *out;
+	u8 iv[MAX_IVLEN];
+};
+
+static int bench_submit(enum bench_kind kind, int enc, void *req)
+{
+	switch (kind) {
+	case BENCH_AHASH:
+		return crypto_ahash_digest(req);
+	case BENCH_SKCIPHER:
+		return enc ? crypto_skcipher_encrypt(req) :
+			     crypto_skcipher_decrypt(req);
+	case BENCH_AEAD:
+		return enc ? crypto_aead_encrypt(req) :
+			     crypto_aead_decrypt(req);
+	}
+
+	return -EINVAL;
+}
+
+static int bench_round(struct bench_data *data, enum bench_kind kind, int enc,
+		       int *rc)
+{
+	int i, err = 0;
+
+	for (i = 0; i < num_mb; i++)
+		rc[i] = bench_submit(kind, enc, data[i].req);
+
+	for (i = 0; i < num_mb; i++) {
+		rc[i] = crypto_wait_req(rc[i], &data[i].wait);
+		if (rc[i])
+			err = rc[i];
+	}
+
+	return err;
+}
+
+/*
+ * Point the requests at @size bytes of input. AEAD decryption needs valid
+ * ciphertext, so it is produced here by encrypting the input first and the
+ * benchmark then decrypts out[] into in[].
+ */
+static int bench_setup(struct bench_data *data, enum bench_kind kind, int enc,
+		       unsigned int size, unsigned int authsize, int *rc)
+{
+	int i, err;
+
+	for (i = 0; i < num_mb; i++) {
+		struct bench_data *d = &data[i];
+
+		sg_init_one(&d->src, d->in, size + authsize);
+		sg_init_one(&d->dst, d->out, size + authsize);
+
+		switch (kind) {
+		case BENCH_AHASH:
+			ahash_request_set_crypt(d->req, &d->src, d->out, size);
+			break;
+		case BENCH_SKCIPHER:
+			skcipher_request_set_crypt(d->req, &d->src, &d->dst,
+						   size, d->iv);
+			break;
+		case BENCH_AEAD:
+			aead_request_set_ad(d->req, 0);
+			aead_request_set_crypt(d->req, &d->src, &d->dst,
+					       size, d->iv);
+			break;
+		}
+	}
+
+	if (kind != BENCH_AEAD || enc)
+		return 0;
+
+	err = bench_round(data, kind, ENCRYPT, rc);
+	if (err)
+		return err;
+
+	for (i = 0; i < num_mb; i++)
+		aead_request_set_crypt(data[i].req, &data[i].dst,
+				       &data[i].src, size + authsize,
+				       data[i].iv);
+
+	return 0;
+}
+
+/*
+ * Without klen= the key length isn't known up front, so try the common ones
+ * until the transform accepts one: plain and RFC 4106/4309/7539 AEADs take
+ * the raw key, authenc() wants an rtattr encoded authentication and cipher
+ * key pair, in which case klen= is the length of the cipher key.
+ */
+static int bench_aead_setkey(struct crypto_aead *tfm, const char *algo,
+			     const u8 *key)
+{
+	static const unsigned int klens[] = { 16, 32, 24, 20, 36, 19, 8, 0 };
+	struct crypto_authenc_key_param *param;
+	u8 buf[RTA_SPACE(sizeof(*param)) + BENCH_AUTHKEY_LEN + 64] __aligned(4);
+	bool authenc = !strncmp(algo, "authenc", 7);
+	struct rtattr *rta = (struct rtattr *)buf;
+	int i, ret = -EINVAL;
+
+	for (i = 0; i < ARRAY_SIZE(klens); i++) {
+		unsigned int klen = bench_klen ?: klens[i];
+
+		if (!authenc) {
+			ret = crypto_aead_setkey(tfm, key, klen);
+		} else {
+			rta->rta_type = CRYPTO_AUTHENC_KEYA_PARAM;
+			rta->rta_len = RTA_LENGTH(sizeof(*param));
+			param = RTA_DATA(rta);
+			param->enckeylen = cpu_to_be32(klen);
+			memcpy(buf + RTA_SPACE(sizeof(*param)), key,
+			       BENCH_AUTHKEY_LEN);
+			memcpy(buf + RTA_SPACE(sizeof(*param)) + BENCH_AUTHKEY_LEN,
+			       key, klen);
+			ret = crypto_aead_setkey(tfm, buf,
+						 RTA_SPACE(sizeof(*param)) +
+						 BENCH_AUTHKEY_LEN + klen);
+		}
+		if (ret != -EINVAL || bench_klen)
+			break;
+	}
+
+	return ret;
+}
+
+static int bench_cmp_u64(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void test_bench(const char *algo, enum bench_kind kind, int enc)
+{
+	static const char * const ops[] = {
+		[BENCH_AHASH]		= "digest",
+		[BENCH_SKCIPHER]	= "encrypt",
+		[BENCH_AEAD]		= "encrypt",
+	};
+	struct crypto_tfm *base;
+	struct bench_data *data;
+	unsigned int authsize = 0;
+	unsigned int *sizes;
+	int nsizes;
+	void *tfm;
+	u8 key[64];
+	int *rc;
+	u64 *lat;
+	int i, j;
+	int ret;
+
+	if (!algo) {
+		pr_err("benchmark modes need alg=\n");
+		return;
+	}
+
+	if (bench_num_sizes) {
+		sizes = bench_sizes;
+		nsizes = bench_num_sizes;
+	} else {
+		sizes = block_sizes;
+		nsizes = ARRAY_SIZE(block_sizes) - 1;
+	}
+
+	if (!bench_iters || !num_mb) {
+		pr_err("benchmark modes need non-zero iters= and num_mb=\n");
+		return;
+	}
+
+	if (bench_klen > sizeof(key)) {
+		pr_err("benchmark klen=%u exceeds %zu bytes\n", bench_klen,
+		       sizeof(key));
+		return;
+	}
+
+	for (i = 0; i < sizeof(key); i++)
+		key[i] = i * 0x11 + 1;
+
+	switch (kind) {
+	case BENCH_AHASH:
+		tfm = crypto_alloc_ahash(algo, type, mask);
+		break;
+	case BENCH_SKCIPHER:
+		tfm = crypto_alloc_skcipher(algo, type, mask);
+		break;
+	default:
+		tfm = crypto_alloc_aead(algo, type, mask);
+		break;
+	}
+	if (IS_ERR(tfm)) {
+		pr_err("failed to load transform for %s: %ld\n", algo,
+		       PTR_ERR(tfm));
+		return;
+	}
+
+	switch (kind) {
+	case BENCH_AHASH:
+		base = crypto_ahash_tfm(tfm);
+		ret = bench_klen ? crypto_ahash_setkey(tfm, key, bench_klen) : 0;
+		break;
+	case BENCH_SKCIPHER:
+		base = crypto_skcipher_tfm(tfm);
+		ret = crypto_skcipher_setkey(tfm, key, bench_klen ?:
+					     crypto_skcipher_max_keysize(tfm));
+		break;
+	default:
+		base = crypto_aead_tfm(tfm);
+		authsize = crypto_aead_authsize(tfm);
+		ret = bench_aead_setkey(tfm, algo, key);
+		break;
+	}
+	if (ret) {
+		pr_err("setkey failed for %s: %d\n", algo, ret);
+		goto out_free_tfm;
+	}
+
+	data = kcalloc(num_mb, sizeof(*data), GFP_KERNEL);
+	rc = kcalloc(num_mb, sizeof(*rc), GFP_KERNEL);
+	lat = kvmalloc_array(bench_iters, sizeof(*lat), GFP_KERNEL);
+	if (!data || !rc || !lat)
+		goto out_free;
+
+	for (i = 0; i < num_mb; i++) {
+		struct bench_data *d = &data[i];
+
+		d->in = kzalloc(BENCH_MAX_SIZE + MAX_DIGEST_SIZE, GFP_KERNEL);
+		d->out = kzalloc(BENCH_MAX_SIZE + MAX_DIGEST_SIZE, GFP_KERNEL);
+		if (!d->in || !d->out)
+			goto out_free_reqs;
+
+		crypto_init_wait(&d->wait);
+
+		switch (kind) {
+		case BENCH_AHASH:
+			d->req = ahash_request_alloc(tfm, GFP_KERNEL);
+			if (d->req)
+				ahash_request_set_callback(d->req,
+						CRYPTO_TFM_REQ_MAY_BACKLOG,
+						crypto_req_done, &d->wait);
+			break;
+		case BENCH_SKCIPHER:
+			d->req = skcipher_request_alloc(tfm, GFP_KERNEL);
+			if (d->req)
+				skcipher_request_set_callback(d->req,
+						CRYPTO_TFM_REQ_MAY_BACKLOG,
+						crypto_req_done, &d->wait);
+			break;
+		default:
+			d->req = aead_request_alloc(tfm, GFP_KERNEL);
+			if (d->req)
+				aead_request_set_callback(d->req,
+						CRYPTO_TFM_REQ_MAY_BACKLOG,
+						crypto_req_done, &d->wait);
+			break;
+		}
+		if (!d->req)
+			goto out_free_reqs;
+	}
+
+	for (j = 0; j < nsizes; j++) {
+		unsigned int size = sizes[j];
+		u64 total = 0, bytes;
+
+		if (!size || size > BENCH_MAX_SIZE) {
+			pr_err("benchmark size %u out of range\n", size);
+			break;
+		}
+
+		ret = bench_setup(data, kind, enc, size, authsize, rc);
+		if (ret)
+			goto out_err;
+
+		/* Warm-up run. */
+		for (i = 0; i < 4; i++) {
+			ret = bench_round(data, kind, enc, rc);
+			if (ret)
+				goto out_err;
+		}
+
+		for (i = 0; i < bench_iters; i++) {
+			u64 start = ktime_get_ns();
+
+			ret = bench_round(data, kind, enc, rc);
+			if (ret)
+				goto out_err;
+
+			lat[i] = ktime_get_ns() - start;
+			total += lat[i];
+			cond_resched();
+		}
+
+		sort(lat, bench_iters, sizeof(*lat), bench_cmp_u64, NULL);
+		bytes = (u64)bench_iters * num_mb * size;
+
+		pr_info("bench alg=%s driver=%s op=%s size=%u reqs=%u iters=%u mb_per_s=%llu p50_ns=%llu p90_ns=%llu p99_ns=%llu max_ns=%llu\n",
+			algo, crypto_tfm_alg_driver_name(base),
+			enc ? ops[kind] : "decrypt", size, num_mb, bench_iters,
+			div64_u64(bytes * 1000, total ?: 1),
+			lat[bench_iters * 50 / 100], lat[bench_iters * 90 / 100],
+			lat[bench_iters * 99 / 100], lat[bench_iters - 1]);
+	}
+	goto out_free_reqs;
+
+out_err:
+	pr_err("bench alg=%s size=%u failed: %d\n", algo, sizes[j], ret);
+out_free_reqs:
+	for (i = 0; i < num_mb; i++) {
+		kfree(data[i].in);
+		kfree(data[i].out);
+		kzfree(data[i].req);
+	}
+out_free:
+	kvfree(lat);
+	kfree(rc);
+	kfree(data);
+out_free_tfm:
+	switch (kind) {
+	case BENCH_AHASH:
+		crypto_free_ahash(tfm);
+		break;
+	case BENCH_SKCIPHER:
+		crypto_free_skcipher(tfm);
+		break;
+	default:
+		crypto_free_aead(tfm);
+		break;
+	}
+}
+
 static void test_available(void)
 {
 	char **name = check;
@@ -3013,6 +3524,63 @@ static int do_test(const char *alg, u32 type, u32 mask, int m, u32 num_mb)
 				       speed_template_8_32, num_mb);
 		break;
 
+	case 700:
+		if (alg) {
+			test_comp_speed(alg, sec);
+			break;
+		}
+		/* fall through */
+	case 701:
+		test_comp_speed("deflate", sec);
+		if (mode > 700 && mode < 800) break;
+		/* fall through */
+	case 702:
+		test_comp_speed("lzo", sec);
+		if (mode > 700 && mode < 800) break;
+		/* fall through */
+	case 703:
+		test_comp_speed("lzo-rle", sec);
+		if (mode > 700 && mode < 800) break;
+		/* fall through */
+	case 704:
+		test_comp_speed("lz4", sec);
+		if (mode > 700 && mode < 800) break;
+		/* fall through */
+	case 705:
+		test_comp_speed("lz4hc", sec);
+		if (mode > 700 && mode < 800) break;
+		/* fall through */
+	case 706:
+		test_comp_speed("zstd", sec);
+		if (mode > 700 && mode < 800) break;
+		/* fall through */
+	case 707:
+		test_comp_speed("842", sec);
+		if (mode > 700 && mode < 800) break;
+		/* fall through */
+	case 799:
+		break;
+
+	case 800:
+		test_bench(alg, BENCH_AHASH, ENCRYPT);
+		break;
+
+	case 801:
+		test_bench(alg, BENCH_SKCIPHER, ENCRYPT);
+		break;
+
+	case 802:
+		test_bench(alg, BENCH_SKCIPHER, DECRYPT);
+		break;
+
+	case 803:
+		test_bench(alg, BENCH_AEAD, ENCRYPT);
+		break;
+
+	case 804:
+		test_bench(alg, BENCH_AEAD, DECRYPT);
+		break;
+
 	case 1000:
 		test_available();
 		break;
@@ -3076,6 +3644,12 @@ MODULE_PARM_DESC(sec, "Length in seconds of speed tests "
 		      "(defaults to zero which uses CPU cycles instead)");
 module_param(num_mb, uint, 0000);
 MODULE_PARM_DESC(num_mb, "Number of concurrent requests to be used in mb speed tests (defaults to 8)");
+module_param_array_named(sizes, bench_sizes, uint, &bench_num_sizes, 0);
+MODULE_PARM_DESC(sizes, "Buffer sizes for the benchmark modes, comma separated");
+module_param_named(iters, bench_iters, uint, 0);
+MODULE_PARM_DESC(iters, "Rounds measured per size in the benchmark modes (defaults to 1024)");
+module_param_named(klen, bench_klen, uint, 0);
+MODULE_PARM_DESC(klen, "Key length for the benchmark modes (cipher key length for authenc)");
 
 MODULE_LICENSE("GPL");
 MODULE_DESCRIPTION("Quick & dirty crypto testing module");
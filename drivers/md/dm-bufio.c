@@ -78,6 +78,16 @@
  *	context), so some clean-not-writing buffers can be held on
  *	dirty_lru too.  They are later added to lru in the process
  *	context.
+ *
+ * Lockless lookups:
+ *	The hit path of dm_bufio_get and dm_bufio_read walks buffer_tree
+ *	under RCU, validated by tree_seq, and takes a hold count without
+ *	the client lock.  Struct dm_buffer is SLAB_TYPESAFE_BY_RCU for
+ *	that.  A buffer with no holders has hold_count 0; whoever wants to
+ *	evict, free or move it must first claim it by changing hold_count
+ *	to B_HOLD_CLAIMED, which lockless lookups never increment.  Such
+ *	hits don't move the buffer in the LRU, they set "referenced"
+ *	instead and __get_unclaimed_buffer gives it a second chance.
  */
 struct dm_bufio_client {
 	struct mutex lock;
@@ -101,6 +111,8 @@ struct dm_bufio_client {
 	unsigned minimum_buffers;
 
 	struct rb_root buffer_tree;
+	seqcount_t tree_seq;
+	bool block_moving;
 	wait_queue_head_t free_buffer_wait;
 
 	sector_t start;
@@ -109,6 +121,18 @@ struct dm_bufio_client {
 
 	struct list_head client_list;
 	struct shrinker shrinker;
+
+	struct dm_bufio_stats __percpu *stats;
+};
+
+/*
+ * Lookup statistics, summed up over all cpus and clients in the
+ * hits/misses/lock_contended parameters.
+ */
+struct dm_bufio_stats {
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long lock_contended;
 };
 
 /*
@@ -118,6 +142,11 @@ struct dm_bufio_client {
 #define B_WRITING	1
 #define B_DIRTY		2
 
+/*
+ * dm_buffer->hold_count of a buffer that is being evicted, freed or moved
+ */
+#define B_HOLD_CLAIMED	(-1)
+
 /*
  * Describes how the block was allocated:
  * kmem_cache_alloc(), __get_free_pages() or vmalloc().
@@ -138,10 +167,11 @@ struct dm_buffer {
 	void *data;
 	unsigned char data_mode;		/* DATA_MODE_* */
 	unsigned char list_mode;		/* LIST_* */
+	unsigned char referenced;		/* hit without the client lock */
 	blk_status_t read_error;
 	blk_status_t write_error;
 	unsigned accessed;
-	unsigned hold_count;
+	atomic_t hold_count;
 	unsigned long state;
 	unsigned long last_accessed;
 	unsigned dirty_start;
@@ -164,7 +194,11 @@ struct dm_buffer {
 
 static void dm_bufio_lock(struct dm_bufio_client *c)
 {
+	bool contended = mutex_is_locked(&c->lock);
+
 	mutex_lock_nested(&c->lock, dm_bufio_in_request());
+	if (contended)
+		this_cpu_inc(c->stats->lock_contended);
 }
 
 static int dm_bufio_trylock(struct dm_bufio_client *c)
@@ -262,6 +296,63 @@ static struct dm_buffer *__find(struct dm_bufio_client *c, sector_t block)
 	return NULL;
 }
 
+/*
+ * Lockless version of __find for the hit path, see "Lockless lookups".
+ * Returns the buffer held, or NULL if the caller has to retry under the
+ * client lock.
+ */
+static struct dm_buffer *__find_get_lockless(struct dm_bufio_client *c, sector_t block)
+{
+	struct dm_buffer *b = NULL;
+	struct rb_node *n;
+	bool stale;
+	unsigned seq;
+
+	rcu_read_lock();
+
+	seq = raw_read_seqcount(&c->tree_seq);
+	if (seq & 1)
+		goto out;
+
+	n = rcu_dereference_raw(c->buffer_tree.rb_node);
+	while (n) {
+		b = container_of(n, struct dm_buffer, node);
+
+		if (b->block == block)
+			break;
+
+		n = (b->block < block) ? rcu_dereference_raw(n->rb_left) :
+					 rcu_dereference_raw(n->rb_right);
+	}
+
+	if (!n || !atomic_inc_unless_negative(&b->hold_count)) {
+		b = NULL;
+		goto out;
+	}
+
+	/*
+	 * block_moving goes first: seeing it cleared by
+	 * dm_bufio_release_move() then guarantees, pairing with the
+	 * smp_wmb() there, that the relinks are seen by the checks below.
+	 */
+	stale = READ_ONCE(c->block_moving);
+	smp_rmb();
+	stale = stale || b->block != block ||
+		read_seqcount_retry(&c->tree_seq, seq);
+	rcu_read_unlock();
+
+	if (unlikely(stale)) {
+		dm_bufio_release(b);
+		return NULL;
+	}
+
+	return b;
+
+out:
+	rcu_read_unlock();
+	return b;
+}
+
 static void __insert(struct dm_bufio_client *c, struct dm_buffer *b)
 {
 	struct rb_node **new = &c->buffer_tree.rb_node, *parent = NULL;
@@ -280,13 +371,26 @@ static void __insert(struct dm_bufio_client *c, struct dm_buffer *b)
 			&((*new)->rb_left) : &((*new)->rb_right);
 	}
 
+	write_seqcount_begin(&c->tree_seq);
 	rb_link_node(&b->node, parent, new);
 	rb_insert_color(&b->node, &c->buffer_tree);
+	write_seqcount_end(&c->tree_seq);
 }
 
 static void __remove(struct dm_bufio_client *c, struct dm_buffer *b)
 {
+	write_seqcount_begin(&c->tree_seq);
 	rb_erase(&b->node, &c->buffer_tree);
+	write_seqcount_end(&c->tree_seq);
+}
+
+/*
+ * Take a buffer nobody holds away from lockless lookups before evicting,
+ * freeing or moving it.
+ */
+static bool __claim_buffer(struct dm_buffer *b)
+{
+	return atomic_cmpxchg(&b->hold_count, 0, B_HOLD_CLAIMED) == 0;
 }
 
 /*----------------------------------------------------------------*/
@@ -481,6 +585,7 @@ static void __link_buffer(struct dm_buffer *b, sector_t block, int dirty)
 	c->n_buffers[dirty]++;
 	b->block = block;
 	b->list_mode = dirty;
+	b->referenced = 0;
 	list_add(&b->lru_list, &c->lru[dirty]);
 	__insert(b->c, b);
 	b->last_accessed = jiffies;
@@ -513,6 +618,16 @@ static void __relink_lru(struct dm_buffer *b, int dirty)
 
 	b->accessed = 1;
 
+	/*
+	 * Ages are only tracked to a jiffy, so a buffer that is on the right
+	 * list and was relinked in this jiffy is left where it is, even if
+	 * other buffers were relinked in front of it since. This keeps
+	 * repeated hits on hot metadata from rewriting the list heads each
+	 * time.
+	 */
+	if (b->list_mode == dirty && b->last_accessed == jiffies)
+		return;
+
 	BUG_ON(!c->n_buffers[b->list_mode]);
 
 	c->n_buffers[b->list_mode]--;
@@ -746,7 +861,7 @@ static void __flush_write_list(struct list_head *write_list)
  */
 static void __make_buffer_clean(struct dm_buffer *b)
 {
-	BUG_ON(b->hold_count);
+	BUG_ON(atomic_read(&b->hold_count) != B_HOLD_CLAIMED);
 
 	if (!b->state)	/* fast case */
 		return;
@@ -762,13 +877,19 @@ static void __make_buffer_clean(struct dm_buffer *b)
  */
 static struct dm_buffer *__get_unclaimed_buffer(struct dm_bufio_client *c)
 {
-	struct dm_buffer *b;
+	struct dm_buffer *b, *tmp;
 
-	list_for_each_entry_reverse(b, &c->lru[LIST_CLEAN], lru_list) {
+	list_for_each_entry_safe_reverse(b, tmp, &c->lru[LIST_CLEAN], lru_list) {
 		BUG_ON(test_bit(B_WRITING, &b->state));
 		BUG_ON(test_bit(B_DIRTY, &b->state));
 
-		if (!b->hold_count) {
+		if (READ_ONCE(b->referenced)) {
+			WRITE_ONCE(b->referenced, 0);
+			list_move(&b->lru_list, &c->lru[LIST_CLEAN]);
+			continue;
+		}
+
+		if (__claim_buffer(b)) {
 			__make_buffer_clean(b);
 			__unlink_buffer(b);
 			return b;
@@ -779,7 +900,7 @@ static struct dm_buffer *__get_unclaimed_buffer(struct dm_bufio_client *c)
 	list_for_each_entry_reverse(b, &c->lru[LIST_DIRTY], lru_list) {
 		BUG_ON(test_bit(B_READING, &b->state));
 
-		if (!b->hold_count) {
+		if (__claim_buffer(b)) {
 			__make_buffer_clean(b);
 			__unlink_buffer(b);
 			return b;
@@ -956,9 +1077,12 @@ static struct dm_buffer *__bufio_new(struct dm_bufio_client *c, sector_t block,
 	*need_submit = 0;
 
 	b = __find(c, block);
-	if (b)
+	if (b) {
+		this_cpu_inc(c->stats->hits);
 		goto found_buffer;
+	}
 
+	this_cpu_inc(c->stats->misses);
 	if (nf == NF_GET)
 		return NULL;
 
@@ -979,7 +1103,7 @@ static struct dm_buffer *__bufio_new(struct dm_bufio_client *c, sector_t block,
 	__check_watermark(c, write_list);
 
 	b = new_b;
-	b->hold_count = 1;
+	atomic_set(&b->hold_count, 1);
 	b->read_error = 0;
 	b->write_error = 0;
 	__link_buffer(b, block, LIST_CLEAN);
@@ -1007,7 +1131,7 @@ static struct dm_buffer *__bufio_new(struct dm_bufio_client *c, sector_t block,
 	if (nf == NF_GET && unlikely(test_bit(B_READING, &b->state)))
 		return NULL;
 
-	b->hold_count++;
+	atomic_inc(&b->hold_count);
 	__relink_lru(b, test_bit(B_DIRTY, &b->state) ||
 		     test_bit(B_WRITING, &b->state));
 	return b;
@@ -1044,10 +1168,26 @@ static void *new_read(struct dm_bufio_client *c, sector_t block,
 
 	LIST_HEAD(write_list);
 
+	if (nf == NF_GET || nf == NF_READ) {
+		b = __find_get_lockless(c, block);
+		if (b) {
+			this_cpu_inc(c->stats->hits);
+			WRITE_ONCE(b->accessed, 1);
+			WRITE_ONCE(b->referenced, 1);
+			WRITE_ONCE(b->last_accessed, jiffies);
+			/* see the comment at found_buffer in __bufio_new */
+			if (nf == NF_GET && unlikely(test_bit(B_READING, &b->state))) {
+				dm_bufio_release(b);
+				return NULL;
+			}
+			goto wait_read;
+		}
+	}
+
 	dm_bufio_lock(c);
 	b = __bufio_new(c, block, nf, &need_submit, &write_list);
 #ifdef CONFIG_DM_DEBUG_BLOCK_STACK_TRACING
-	if (b && b->hold_count == 1)
+	if (b && atomic_read(&b->hold_count) == 1)
 		buffer_record_stack(b);
 #endif
 	dm_bufio_unlock(c);
@@ -1060,6 +1200,7 @@ static void *new_read(struct dm_bufio_client *c, sector_t block,
 	if (need_submit)
 		submit_io(b, REQ_OP_READ, read_endio);
 
+wait_read:
 	wait_on_bit_io(&b->state, B_READING, TASK_UNINTERRUPTIBLE);
 
 	if (b->read_error) {
@@ -1150,12 +1291,15 @@ void dm_bufio_release(struct dm_buffer *b)
 {
 	struct dm_bufio_client *c = b->c;
 
+	/* Not the last holder, there is nobody to wake and nothing to free */
+	if (atomic_add_unless(&b->hold_count, -1, 1))
+		return;
+
 	dm_bufio_lock(c);
 
-	BUG_ON(!b->hold_count);
+	BUG_ON(atomic_read(&b->hold_count) <= 0);
 
-	b->hold_count--;
-	if (!b->hold_count) {
+	if (atomic_dec_and_test(&b->hold_count)) {
 		wake_up(&c->free_buffer_wait);
 
 		/*
@@ -1166,7 +1310,8 @@ void dm_bufio_release(struct dm_buffer *b)
 		if ((b->read_error || b->write_error) &&
 		    !test_bit(B_READING, &b->state) &&
 		    !test_bit(B_WRITING, &b->state) &&
-		    !test_bit(B_DIRTY, &b->state)) {
+		    !test_bit(B_DIRTY, &b->state) &&
+		    __claim_buffer(b)) {
 			__unlink_buffer(b);
 			__free_buffer_wake(b);
 		}
@@ -1255,12 +1400,12 @@ int dm_bufio_write_dirty_buffers(struct dm_bufio_client *c)
 		if (test_bit(B_WRITING, &b->state)) {
 			if (buffers_processed < c->n_buffers[LIST_DIRTY]) {
 				dropped_lock = 1;
-				b->hold_count++;
+				atomic_inc(&b->hold_count);
 				dm_bufio_unlock(c);
 				wait_on_bit_io(&b->state, B_WRITING,
 					       TASK_UNINTERRUPTIBLE);
 				dm_bufio_lock(c);
-				b->hold_count--;
+				atomic_dec(&b->hold_count);
 			} else
 				wait_on_bit_io(&b->state, B_WRITING,
 					       TASK_UNINTERRUPTIBLE);
@@ -1349,7 +1494,7 @@ void dm_bufio_release_move(struct dm_buffer *b, sector_t new_block)
 retry:
 	new = __find(c, new_block);
 	if (new) {
-		if (new->hold_count) {
+		if (!__claim_buffer(new)) {
 			__wait_for_free_buffer(c);
 			goto retry;
 		}
@@ -1363,11 +1508,11 @@ void dm_bufio_release_move(struct dm_buffer *b, sector_t new_block)
 		__free_buffer_wake(new);
 	}
 
-	BUG_ON(!b->hold_count);
+	BUG_ON(atomic_read(&b->hold_count) <= 0);
 	BUG_ON(test_bit(B_READING, &b->state));
 
 	__write_dirty_buffer(b, NULL);
-	if (b->hold_count == 1) {
+	if (atomic_cmpxchg(&b->hold_count, 1, B_HOLD_CLAIMED) == 1) {
 		wait_on_bit_io(&b->state, B_WRITING,
 			       TASK_UNINTERRUPTIBLE);
 		set_bit(B_DIRTY, &b->state);
@@ -1375,6 +1520,7 @@ void dm_bufio_release_move(struct dm_buffer *b, sector_t new_block)
 		b->dirty_end = c->block_size;
 		__unlink_buffer(b);
 		__link_buffer(b, new_block, LIST_DIRTY);
+		atomic_set(&b->hold_count, 1);
 	} else {
 		sector_t old_block;
 		wait_on_bit_lock_io(&b->state, B_WRITING,
@@ -1384,9 +1530,12 @@ void dm_bufio_release_move(struct dm_buffer *b, sector_t new_block)
 		 * sees "new_block" as a block number.
 		 * After the write, link the buffer back to old_block.
 		 * All this must be done in bufio lock, so that block number
-		 * change isn't visible to other threads.
+		 * change isn't visible to other threads. Lockless lookups
+		 * are kept off by block_moving.
 		 */
 		old_block = b->block;
+		WRITE_ONCE(c->block_moving, true);
+		smp_mb();
 		__unlink_buffer(b);
 		__link_buffer(b, new_block, b->list_mode);
 		submit_io(b, REQ_OP_WRITE, write_endio);
@@ -1394,6 +1543,9 @@ void dm_bufio_release_move(struct dm_buffer *b, sector_t new_block)
 			       TASK_UNINTERRUPTIBLE);
 		__unlink_buffer(b);
 		__link_buffer(b, old_block, b->list_mode);
+		/* pairs with smp_rmb() in __find_get_lockless() */
+		smp_wmb();
+		WRITE_ONCE(c->block_moving, false);
 	}
 
 	dm_bufio_unlock(c);
@@ -1414,7 +1566,7 @@ void dm_bufio_forget(struct dm_bufio_client *c, sector_t block)
 	dm_bufio_lock(c);
 
 	b = __find(c, block);
-	if (b && likely(!b->hold_count) && likely(!b->state)) {
+	if (b && likely(!b->state) && __claim_buffer(b)) {
 		__unlink_buffer(b);
 		__free_buffer_wake(b);
 	}
@@ -1492,12 +1644,12 @@ static void drop_buffers(struct dm_bufio_client *c)
 		list_for_each_entry(b, &c->lru[i], lru_list) {
 			WARN_ON(!warned);
 			warned = true;
-			DMERR("leaked buffer %llx, hold count %u, list %d",
-			      (unsigned long long)b->block, b->hold_count, i);
+			DMERR("leaked buffer %llx, hold count %d, list %d",
+			      (unsigned long long)b->block, atomic_read(&b->hold_count), i);
 #ifdef CONFIG_DM_DEBUG_BLOCK_STACK_TRACING
 			stack_trace_print(b->stack_entries, b->stack_len, 1);
 			/* mark unclaimed to avoid BUG_ON below */
-			b->hold_count = 0;
+			atomic_set(&b->hold_count, 0);
 #endif
 		}
 
@@ -1529,7 +1681,7 @@ static bool __try_evict_buffer(struct dm_buffer *b, gfp_t gfp)
 			return false;
 	}
 
-	if (b->hold_count)
+	if (!__claim_buffer(b))
 		return false;
 
 	__make_buffer_clean(b);
@@ -1599,6 +1751,17 @@ dm_bufio_shrink_count(struct shrinker *shrink, struct shrink_control *sc)
 	return (count < retain_target) ? 0 : (count - retain_target);
 }
 
+/*
+ * Lockless lookups may look at a buffer after it has been freed and
+ * reused, it must never appear unclaimed while it is not linked.
+ */
+static void dm_buffer_ctor(void *p)
+{
+	struct dm_buffer *b = p;
+
+	atomic_set(&b->hold_count, B_HOLD_CLAIMED);
+}
+
 /*
  * Create the buffering interface
  */
@@ -1624,6 +1787,13 @@ struct dm_bufio_client *dm_bufio_client_create(struct block_device *bdev, unsign
 		goto bad_client;
 	}
 	c->buffer_tree = RB_ROOT;
+	seqcount_init(&c->tree_seq);
+
+	c->stats = alloc_percpu(struct dm_bufio_stats);
+	if (!c->stats) {
+		r = -ENOMEM;
+		goto bad_stats;
+	}
 
 	c->bdev = bdev;
 	c->block_size = block_size;
@@ -1671,7 +1841,8 @@ struct dm_bufio_client *dm_bufio_client_create(struct block_device *bdev, unsign
 	else
 		snprintf(slab_name, sizeof slab_name, "dm_bufio_buffer");
 	c->slab_buffer = kmem_cache_create(slab_name, sizeof(struct dm_buffer) + aux_size,
-					   0, SLAB_RECLAIM_ACCOUNT, NULL);
+					   0, SLAB_RECLAIM_ACCOUNT | SLAB_TYPESAFE_BY_RCU,
+					   dm_buffer_ctor);
 	if (!c->slab_buffer) {
 		r = -ENOMEM;
 		goto bad;
@@ -1715,6 +1886,8 @@ struct dm_bufio_client *dm_bufio_client_create(struct block_device *bdev, unsign
 	dm_io_client_destroy(c->dm_io);
 bad_dm_io:
 	mutex_destroy(&c->lock);
+	free_percpu(c->stats);
+bad_stats:
 	kfree(c);
 bad_client:
 	return ERR_PTR(r);
@@ -1762,6 +1935,7 @@ void dm_bufio_client_destroy(struct dm_bufio_client *c)
 	kmem_cache_destroy(c->slab_buffer);
 	dm_io_client_destroy(c->dm_io);
 	mutex_destroy(&c->lock);
+	free_percpu(c->stats);
 	kfree(c);
 }
 EXPORT_SYMBOL_GPL(dm_bufio_client_destroy);
@@ -1998,6 +2172,31 @@ static void __exit dm_bufio_exit(void)
 module_init(dm_bufio_init)
 module_exit(dm_bufio_exit)
 
+static int dm_bufio_get_client_stat(char *buffer, const struct kernel_param *kp)
+{
+	size_t offset = (size_t)kp->arg;
+	struct dm_bufio_client *c;
+	unsigned long sum = 0;
+	int cpu;
+
+	mutex_lock(&dm_bufio_clients_lock);
+	list_for_each_entry(c, &dm_bufio_all_clients, client_list)
+		for_each_possible_cpu(cpu)
+			sum += READ_ONCE(*(unsigned long *)
+					 ((char *)per_cpu_ptr(c->stats, cpu) + offset));
+	mutex_unlock(&dm_bufio_clients_lock);
+
+	return sprintf(buffer, "%lu\n", sum);
+}
+
+static const struct kernel_param_ops dm_bufio_client_stat_ops = {
+	.get = dm_bufio_get_client_stat,
+};
+
+#define dm_bufio_client_stat_param(name)					\
+	module_param_cb(name, &dm_bufio_client_stat_ops,			\
+			(void *)offsetof(struct dm_bufio_stats, name), S_IRUGO)
+
 module_param_named(max_cache_size_bytes, dm_bufio_cache_size, ulong, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(max_cache_size_bytes, "Size of metadata cache");
 
@@ -2022,6 +2221,15 @@ MODULE_PARM_DESC(allocated_vmalloc_bytes, "Memory allocated with vmalloc");
 module_param_named(current_allocated_bytes, dm_bufio_current_allocated, ulong, S_IRUGO);
 MODULE_PARM_DESC(current_allocated_bytes, "Memory currently used by the cache");
 
+dm_bufio_client_stat_param(hits);
+MODULE_PARM_DESC(hits, "Buffer lookups that found the block cached, over all clients");
+
+dm_bufio_client_stat_param(misses);
+MODULE_PARM_DESC(misses, "Buffer lookups that did not find the block cached, over all clients");
+
+dm_bufio_client_stat_param(lock_contended);
+MODULE_PARM_DESC(lock_contended, "Times a client lock had to be waited for, over all clients");
+
 MODULE_AUTHOR("Mikulas Patocka <dm-devel@redhat.com>");
 MODULE_DESCRIPTION(DM_NAME " buffered I/O library");
 MODULE_LICENSE("GPL");
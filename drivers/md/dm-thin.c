@@ -12,6 +12,7 @@
 #include <linux/dm-io.h>
 #include <linux/dm-kcopyd.h>
 #include <linux/jiffies.h>
+#include <linux/ktime.h>
 #include <linux/log2.h>
 #include <linux/list.h>
 #include <linux/rculist.h>
@@ -226,6 +227,20 @@ typedef void (*process_mapping_fn)(struct dm_thin_new_mapping *m);
 
 #define CELL_SORT_ARRAY_SIZE 8192
 
+/*
+ * Metadata commit latency, reported in the pool status.  Bucket i counts
+ * the commits that took less than 4^i milliseconds, the last bucket
+ * catches everything slower.
+ */
+#define COMMIT_HIST_BUCKETS 7
+
+struct commit_stats {
+	uint64_t count;
+	uint64_t total_us;
+	uint64_t max_us;
+	uint64_t hist[COMMIT_HIST_BUCKETS];
+};
+
 struct pool {
 	struct list_head list;
 	struct dm_target *ti;	/* Only set if a pool target is bound */
@@ -257,6 +272,7 @@ struct pool {
 	unsigned ref_count;
 
 	spinlock_t lock;
+	struct commit_stats commit_stats;
 	struct bio_list deferred_flush_bios;
 	struct bio_list deferred_flush_completions;
 	struct list_head prepared_mappings;
@@ -1488,6 +1504,27 @@ static void check_for_data_space(struct pool *pool)
 	}
 }
 
+static void account_commit(struct pool *pool, u64 us)
+{
+	unsigned long flags;
+	struct commit_stats *cs = &pool->commit_stats;
+	unsigned bucket = 0;
+	u64 ms = us / USEC_PER_MSEC;
+
+	while (ms && bucket < COMMIT_HIST_BUCKETS - 1) {
+		ms >>= 2;
+		bucket++;
+	}
+
+	spin_lock_irqsave(&pool->lock, flags);
+	cs->count++;
+	cs->total_us += us;
+	if (us > cs->max_us)
+		cs->max_us = us;
+	cs->hist[bucket]++;
+	spin_unlock_irqrestore(&pool->lock, flags);
+}
+
 /*
  * A non-zero return indicates read_only or fail_io mode.
  * Many callers don't care about the return value.
@@ -1495,11 +1532,14 @@ static void check_for_data_space(struct pool *pool)
 static int commit(struct pool *pool)
 {
 	int r;
+	ktime_t start;
 
 	if (get_pool_mode(pool) >= PM_OUT_OF_METADATA_SPACE)
 		return -EINVAL;
 
+	start = ktime_get();
 	r = dm_pool_commit_metadata(pool->pmd);
+	account_commit(pool, ktime_us_delta(ktime_get(), start));
 	if (r)
 		metadata_operation_failed(pool, "dm_pool_commit_metadata", r);
 	else {
@@ -3940,6 +3980,9 @@ static void pool_status(struct dm_target *ti, status_type_t type,
 	char buf2[BDEVNAME_SIZE];
 	struct pool_c *pt = ti->private;
 	struct pool *pool = pt->pool;
+	struct commit_stats cs;
+	unsigned long flags;
+	unsigned i;
 
 	switch (type) {
 	case STATUSTYPE_INFO:
@@ -4033,6 +4076,18 @@ static void pool_status(struct dm_target *ti, status_type_t type,
 
 		DMEMIT("%llu ", (unsigned long long)calc_metadata_threshold(pt));
 
+		spin_lock_irqsave(&pool->lock, flags);
+		cs = pool->commit_stats;
+		spin_unlock_irqrestore(&pool->lock, flags);
+
+		DMEMIT("%llu %llu %llu ", (unsigned long long)cs.count,
+		       (unsigned long long)cs.total_us,
+		       (unsigned long long)cs.max_us);
+		for (i = 0; i < COMMIT_HIST_BUCKETS; i++)
+			DMEMIT("%s%llu", i ? ":" : "",
+			       (unsigned long long)cs.hist[i]);
+		DMEMIT(" ");
+
 		break;
 
 	case STATUSTYPE_TABLE:
@@ -4122,7 +4177,7 @@ static struct target_type pool_target = {
 	.name = "thin-pool",
 	.features = DM_TARGET_SINGLETON | DM_TARGET_ALWAYS_WRITEABLE |
 		    DM_TARGET_IMMUTABLE,
-	.version = {1, 22, 0},
+	.version = {1, 23, 0},
 	.module = THIS_MODULE,
 	.ctr = pool_ctr,
 	.dtr = pool_dtr,
@@ -4501,7 +4556,7 @@ static void thin_io_hints(struct dm_target *ti, struct queue_limits *limits)
 
 static struct target_type thin_target = {
 	.name = "thin",
-	.version = {1, 22, 0},
+	.version = {1, 23, 0},
 	.module	= THIS_MODULE,
 	.ctr = thin_ctr,
 	.dtr = thin_dtr,
@@ -254,6 +254,13 @@ static int verity_hash_init(struct dm_verity *v, struct ahash_request *req,
 					crypto_req_done, (void *)wait);
 	crypto_init_wait(wait);
 
+	if (v->initial_hashstate) {
+		r = crypto_ahash_import(req, v->initial_hashstate);
+		if (unlikely(r < 0))
+			DMERR("crypto_ahash_import failed: %d", r);
+		return r;
+	}
+
 	r = crypto_wait_req(crypto_ahash_init(req), wait);
 
 	if (unlikely(r < 0)) {
@@ -914,6 +921,7 @@ static void verity_dtr(struct dm_target *ti)
 
 	kvfree(v->validated_blocks);
 	kfree(v->salt);
+	kfree(v->initial_hashstate);
 	kfree(v->root_digest);
 	kfree(v->zero_digest);
 
@@ -956,6 +964,52 @@ static int verity_alloc_most_once(struct dm_verity *v)
 	return 0;
 }
 
+/*
+ * Format 1 prepends the salt to every block, so the hash state after the
+ * salt is the same for all of them.  Compute it once; hashing a block then
+ * starts with an import instead of an init and an update with the salt.
+ * Not being able to export the state is not an error, the salt is then
+ * hashed for every block as before.
+ */
+static int verity_alloc_initial_hashstate(struct dm_verity *v)
+{
+	struct ahash_request *req;
+	struct crypto_wait wait;
+	u8 *hashstate;
+	int r;
+
+	if (!v->salt_size || !v->version)
+		return 0;
+
+	req = kmalloc(v->ahash_reqsize, GFP_KERNEL);
+	if (!req)
+		return -ENOMEM;
+
+	hashstate = kmalloc(crypto_ahash_statesize(v->tfm), GFP_KERNEL);
+	if (!hashstate) {
+		r = -ENOMEM;
+		goto out;
+	}
+
+	r = verity_hash_init(v, req, &wait);
+	if (r < 0)
+		goto out;
+
+	if (crypto_ahash_export(req, hashstate)) {
+		DMINFO("%s: cannot export hash state, salting every block",
+		       v->alg_name);
+		goto out;
+	}
+
+	v->initial_hashstate = hashstate;
+	hashstate = NULL;
+out:
+	kfree(hashstate);
+	kfree(req);
+
+	return r;
+}
+
 static int verity_alloc_zero_digest(struct dm_verity *v)
 {
 	int r = -ENOMEM;
@@ -1382,6 +1436,12 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		}
 	}
 
+	r = verity_alloc_initial_hashstate(v);
+	if (r) {
+		ti->error = "Cannot compute initial hash state";
+		goto bad;
+	}
+
 	argv += 10;
 	argc -= 10;
 
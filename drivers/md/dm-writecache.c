@@ -23,6 +23,9 @@
 #define MAX_WRITEBACK_JOBS		0
 #define ENDIO_LATENCY			16
 #define WRITEBACK_LATENCY		64
+#define WRITEBACK_MAX_THREADS		32
+#define WRITEBACK_REGION_SHIFT		17	/* sectors, 64MiB */
+#define WATERMARK_ADAPT_INTERVAL	HZ
 #define AUTOCOMMIT_BLOCKS_SSD		65536
 #define AUTOCOMMIT_BLOCKS_PMEM		64
 #define AUTOCOMMIT_MSEC			1000
@@ -119,10 +122,12 @@ struct dm_writecache {
 	size_t writeback_size;
 	size_t freelist_high_watermark;
 	size_t freelist_low_watermark;
+	size_t watermark_boost;
 
 	unsigned uncommitted_blocks;
 	unsigned autocommit_blocks;
 	unsigned max_writeback_jobs;
+	unsigned writeback_threads;
 
 	int error;
 
@@ -160,12 +165,22 @@ struct dm_writecache {
 	bool autocommit_time_set:1;
 	bool writeback_fua_set:1;
 	bool flush_on_suspend:1;
+	bool writeback_threads_set:1;
+	bool adaptive_watermarks:1;
 
 	unsigned writeback_all;
 	struct workqueue_struct *writeback_wq;
 	struct work_struct writeback_work;
 	struct work_struct flush_work;
 
+	struct workqueue_struct *writeback_submit_wq;
+	struct writeback_thread *writeback_thread;
+	atomic_long_t writeback_unsubmitted;
+
+	unsigned long watermark_adapt_jiffies;
+	size_t watermark_adapt_written;
+	unsigned watermark_adapt_stalls;
+
 	struct dm_io_client *dm_io;
 
 	raw_spinlock_t endio_list_lock;
@@ -181,6 +196,19 @@ struct dm_writecache {
 
 	struct bio_set bio_set;
 	mempool_t copy_pool;
+
+	struct {
+		unsigned long long reads;
+		unsigned long long read_hits;
+		unsigned long long writes;
+		unsigned long long write_hits_uncommitted;
+		unsigned long long write_hits_committed;
+		unsigned long long writes_allocate;
+		unsigned long long writes_blocked_on_freelist;
+		unsigned long long freelist_wait_jiffies;
+		unsigned long long flushes;
+		unsigned long long discards;
+	} stats;
 };
 
 #define WB_LIST_INLINE		16
@@ -635,9 +663,19 @@ static void writecache_add_to_freelist(struct dm_writecache *wc, struct wc_entry
 	wc->freelist_size++;
 }
 
+static inline size_t writecache_high_watermark(struct dm_writecache *wc)
+{
+	return wc->freelist_high_watermark + wc->watermark_boost;
+}
+
+static inline size_t writecache_low_watermark(struct dm_writecache *wc)
+{
+	return wc->freelist_low_watermark + wc->watermark_boost;
+}
+
 static inline void writecache_verify_watermark(struct dm_writecache *wc)
 {
-	if (unlikely(wc->freelist_size + wc->writeback_size <= wc->freelist_high_watermark))
+	if (unlikely(wc->freelist_size + wc->writeback_size <= writecache_high_watermark(wc)))
 		queue_work(wc->writeback_wq, &wc->writeback_work);
 }
 
@@ -1059,6 +1097,18 @@ static int process_flush_on_suspend_mesg(unsigned argc, char **argv, struct dm_w
 	return 0;
 }
 
+static int process_clear_stats_mesg(unsigned argc, char **argv, struct dm_writecache *wc)
+{
+	if (argc != 1)
+		return -EINVAL;
+
+	wc_lock(wc);
+	memset(&wc->stats, 0, sizeof wc->stats);
+	wc_unlock(wc);
+
+	return 0;
+}
+
 static int writecache_message(struct dm_target *ti, unsigned argc, char **argv,
 			      char *result, unsigned maxlen)
 {
@@ -1069,6 +1119,8 @@ static int writecache_message(struct dm_target *ti, unsigned argc, char **argv,
 		r = process_flush_mesg(argc, argv, wc);
 	else if (!strcasecmp(argv[0], "flush_on_suspend"))
 		r = process_flush_on_suspend_mesg(argc, argv, wc);
+	else if (!strcasecmp(argv[0], "clear_stats"))
+		r = process_clear_stats_mesg(argc, argv, wc);
 	else
 		DMERR("unrecognised message received: %s", argv[0]);
 
@@ -1168,6 +1220,7 @@ static int writecache_map(struct dm_target *ti, struct bio *bio)
 	wc_lock(wc);
 
 	if (unlikely(bio->bi_opf & REQ_PREFLUSH)) {
+		wc->stats.flushes++;
 		if (writecache_has_error(wc))
 			goto unlock_error;
 		if (WC_MODE_PMEM(wc)) {
@@ -1192,6 +1245,7 @@ static int writecache_map(struct dm_target *ti, struct bio *bio)
 	}
 
 	if (unlikely(bio_op(bio) == REQ_OP_DISCARD)) {
+		wc->stats.discards++;
 		if (writecache_has_error(wc))
 			goto unlock_error;
 		if (WC_MODE_PMEM(wc)) {
@@ -1205,8 +1259,10 @@ static int writecache_map(struct dm_target *ti, struct bio *bio)
 
 	if (bio_data_dir(bio) == READ) {
 read_next_block:
+		wc->stats.reads++;
 		e = writecache_find_entry(wc, bio->bi_iter.bi_sector, WFE_RETURN_FOLLOWING);
 		if (e && read_original_sector(wc, e) == bio->bi_iter.bi_sector) {
+			wc->stats.read_hits++;
 			if (WC_MODE_PMEM(wc)) {
 				bio_copy_block(wc, bio, memory_data(wc, e));
 				if (bio->bi_iter.bi_size)
@@ -1236,22 +1292,32 @@ static int writecache_map(struct dm_target *ti, struct bio *bio)
 				goto unlock_error;
 			e = writecache_find_entry(wc, bio->bi_iter.bi_sector, 0);
 			if (e) {
-				if (!writecache_entry_is_committed(wc, e))
+				if (!writecache_entry_is_committed(wc, e)) {
+					wc->stats.write_hits_uncommitted++;
 					goto bio_copy;
+				}
 				if (!WC_MODE_PMEM(wc) && !e->write_in_progress) {
+					wc->stats.write_hits_committed++;
 					wc->overwrote_committed = true;
 					goto bio_copy;
 				}
 			}
 			e = writecache_pop_from_freelist(wc);
 			if (unlikely(!e)) {
+				unsigned long start = jiffies;
+
 				writecache_wait_on_freelist(wc);
+				wc->stats.writes_blocked_on_freelist++;
+				wc->watermark_adapt_stalls++;
+				wc->stats.freelist_wait_jiffies += jiffies - start;
 				continue;
 			}
+			wc->stats.writes_allocate++;
 			write_original_sector_seq_count(wc, e, bio->bi_iter.bi_sector, wc->seq_count);
 			writecache_insert_entry(wc, e);
 			wc->uncommitted_blocks++;
 bio_copy:
+			wc->stats.writes++;
 			if (WC_MODE_PMEM(wc)) {
 				bio_copy_block(wc, bio, memory_data(wc, e));
 			} else {
@@ -1390,6 +1456,7 @@ static void __writecache_endio_pmem(struct dm_writecache *wc, struct list_head *
 				writecache_free_entry(wc, e);
 			BUG_ON(!wc->writeback_size);
 			wc->writeback_size--;
+			wc->watermark_adapt_written++;
 			n_walked++;
 			if (unlikely(n_walked >= ENDIO_LATENCY)) {
 				writecache_commit_flushed(wc, false);
@@ -1427,12 +1494,43 @@ static void __writecache_endio_ssd(struct dm_writecache *wc, struct list_head *l
 
 			BUG_ON(!wc->writeback_size);
 			wc->writeback_size--;
+			wc->watermark_adapt_written++;
 			e++;
 		} while (--c->n_entries);
 		mempool_free(c, &wc->copy_pool);
 	} while (!list_empty(list));
 }
 
+/*
+ * Foreground writes that had to wait for a free block mean writeback
+ * started too late for the rate at which the origin absorbs it. Start it
+ * earlier by raising both watermarks by what the origin wrote back in a
+ * second, and let the boost decay once the stalls stop.
+ */
+static void writecache_adapt_watermarks(struct dm_writecache *wc)
+{
+	unsigned long elapsed = jiffies - wc->watermark_adapt_jiffies;
+	size_t rate, max_boost;
+
+	if (!wc->adaptive_watermarks || elapsed < WATERMARK_ADAPT_INTERVAL)
+		return;
+
+	rate = div_u64((u64)wc->watermark_adapt_written * HZ, elapsed);
+	max_boost = wc->n_blocks - wc->freelist_low_watermark;
+
+	if (wc->watermark_adapt_stalls)
+		wc->watermark_boost = min(wc->watermark_boost + max_t(size_t, rate, 1),
+					  max_boost);
+	else
+		wc->watermark_boost -= wc->watermark_boost / 4;
+
+	wc->watermark_adapt_jiffies = jiffies;
+	wc->watermark_adapt_written = 0;
+	wc->watermark_adapt_stalls = 0;
+
+	writecache_verify_watermark(wc);
+}
+
 static int writecache_endio_thread(void *data)
 {
 	struct dm_writecache *wc = data;
@@ -1475,6 +1573,8 @@ static int writecache_endio_thread(void *data)
 
 		writecache_commit_flushed(wc, false);
 
+		writecache_adapt_watermarks(wc);
+
 		wc_unlock(wc);
 	}
 
@@ -1497,12 +1597,26 @@ struct writeback_list {
 	size_t size;
 };
 
-static void __writeback_throttle(struct dm_writecache *wc, struct writeback_list *wbl)
+struct writeback_thread {
+	struct work_struct work;
+	struct dm_writecache *wc;
+	struct writeback_list wbl;
+};
+
+/*
+ * writeback_size also counts the entries that the submitters haven't
+ * got to yet, leave those out so that only the I/O in flight is limited.
+ */
+static void __writeback_throttle(struct dm_writecache *wc, size_t submitted)
 {
+	atomic_long_sub(submitted, &wc->writeback_unsubmitted);
+
 	if (unlikely(wc->max_writeback_jobs)) {
-		if (READ_ONCE(wc->writeback_size) - wbl->size >= wc->max_writeback_jobs) {
+		if (READ_ONCE(wc->writeback_size) - atomic_long_read(&wc->writeback_unsubmitted) >=
+		    wc->max_writeback_jobs) {
 			wc_lock(wc);
-			while (wc->writeback_size - wbl->size >= wc->max_writeback_jobs)
+			while (wc->writeback_size - atomic_long_read(&wc->writeback_unsubmitted) >=
+			       wc->max_writeback_jobs)
 				writecache_wait_on_freelist(wc);
 			wc_unlock(wc);
 		}
@@ -1515,7 +1629,7 @@ static void __writecache_writeback_pmem(struct dm_writecache *wc, struct writeba
 	struct wc_entry *e, *f;
 	struct bio *bio;
 	struct writeback_struct *wb;
-	unsigned max_pages;
+	unsigned max_pages, n_entries;
 
 	while (wbl->size) {
 		wbl->size--;
@@ -1556,6 +1670,7 @@ static void __writecache_writeback_pmem(struct dm_writecache *wc, struct writeba
 			e = f;
 		}
 		bio_set_op_attrs(bio, REQ_OP_WRITE, WC_MODE_FUA(wc) * REQ_FUA);
+		n_entries = wb->wc_list_n;
 		if (writecache_has_error(wc)) {
 			bio->bi_status = BLK_STS_IOERR;
 			bio_endio(bio);
@@ -1563,7 +1678,7 @@ static void __writecache_writeback_pmem(struct dm_writecache *wc, struct writeba
 			submit_bio(bio);
 		}
 
-		__writeback_throttle(wc, wbl);
+		__writeback_throttle(wc, n_entries);
 	}
 }
 
@@ -1574,7 +1689,7 @@ static void __writecache_writeback_ssd(struct dm_writecache *wc, struct writebac
 	struct copy_struct *c;
 
 	while (wbl->size) {
-		unsigned n_sectors;
+		unsigned n_sectors, n_entries;
 
 		wbl->size--;
 		e = container_of(wbl->list.prev, struct wc_entry, lru);
@@ -1592,7 +1707,7 @@ static void __writecache_writeback_ssd(struct dm_writecache *wc, struct writebac
 		c = mempool_alloc(&wc->copy_pool, GFP_NOIO);
 		c->wc = wc;
 		c->e = e;
-		c->n_entries = e->wc_list_contiguous;
+		c->n_entries = n_entries = e->wc_list_contiguous;
 
 		while ((n_sectors -= wc->block_size >> SECTOR_SHIFT)) {
 			wbl->size--;
@@ -1604,14 +1719,74 @@ static void __writecache_writeback_ssd(struct dm_writecache *wc, struct writebac
 
 		dm_kcopyd_copy(wc->dm_kcopyd, &from, 1, &to, 0, writecache_copy_endio, c);
 
-		__writeback_throttle(wc, wbl);
+		__writeback_throttle(wc, n_entries);
 	}
 }
 
+static void writecache_writeback_submit(struct dm_writecache *wc, struct writeback_list *wbl)
+{
+	struct blk_plug plug;
+
+	blk_start_plug(&plug);
+
+	if (WC_MODE_PMEM(wc))
+		__writecache_writeback_pmem(wc, wbl);
+	else
+		__writecache_writeback_ssd(wc, wbl);
+
+	blk_finish_plug(&plug);
+}
+
+static void writecache_writeback_thread(struct work_struct *work)
+{
+	struct writeback_thread *t = container_of(work, struct writeback_thread, work);
+
+	writecache_writeback_submit(t->wc, &t->wbl);
+}
+
+/*
+ * Spread the extents over the submission threads by origin region. All of
+ * a region goes to the same thread, so its writes are still issued in the
+ * order they were collected in.
+ */
+static void writecache_writeback_parallel(struct dm_writecache *wc, struct writeback_list *wbl)
+{
+	struct writeback_thread *t;
+	struct wc_entry *e;
+	unsigned i, n;
+
+	for (i = 0; i < wc->writeback_threads; i++) {
+		INIT_LIST_HEAD(&wc->writeback_thread[i].wbl.list);
+		wc->writeback_thread[i].wbl.size = 0;
+	}
+
+	while (wbl->size) {
+		e = container_of(wbl->list.prev, struct wc_entry, lru);
+		i = (unsigned)(read_original_sector(wc, e) >> WRITEBACK_REGION_SHIFT);
+		t = &wc->writeback_thread[i % wc->writeback_threads];
+
+		n = e->wc_list_contiguous;
+		wbl->size -= n;
+		t->wbl.size += n;
+		do {
+			e = container_of(wbl->list.prev, struct wc_entry, lru);
+			list_move(&e->lru, &t->wbl.list);
+		} while (--n);
+	}
+
+	for (i = 1; i < wc->writeback_threads; i++)
+		if (wc->writeback_thread[i].wbl.size)
+			queue_work(wc->writeback_submit_wq, &wc->writeback_thread[i].work);
+
+	writecache_writeback_submit(wc, &wc->writeback_thread[0].wbl);
+
+	for (i = 1; i < wc->writeback_threads; i++)
+		flush_work(&wc->writeback_thread[i].work);
+}
+
 static void writecache_writeback(struct work_struct *work)
 {
 	struct dm_writecache *wc = container_of(work, struct dm_writecache, writeback_work);
-	struct blk_plug plug;
 	struct wc_entry *f, *g, *e = NULL;
 	struct rb_node *node, *next_node;
 	struct list_head skipped;
@@ -1640,7 +1815,7 @@ static void writecache_writeback(struct work_struct *work)
 	wbl.size = 0;
 	while (!list_empty(&wc->lru) &&
 	       (wc->writeback_all ||
-		wc->freelist_size + wc->writeback_size <= wc->freelist_low_watermark)) {
+		wc->freelist_size + wc->writeback_size <= writecache_low_watermark(wc))) {
 
 		n_walked++;
 		if (unlikely(n_walked > WRITEBACK_LATENCY) &&
@@ -1739,16 +1914,14 @@ static void writecache_writeback(struct work_struct *work)
 			writecache_wait_for_writeback(wc);
 	}
 
-	wc_unlock(wc);
+	atomic_long_add(wbl.size, &wc->writeback_unsubmitted);
 
-	blk_start_plug(&plug);
+	wc_unlock(wc);
 
-	if (WC_MODE_PMEM(wc))
-		__writecache_writeback_pmem(wc, &wbl);
+	if (wc->writeback_threads > 1)
+		writecache_writeback_parallel(wc, &wbl);
 	else
-		__writecache_writeback_ssd(wc, &wbl);
-
-	blk_finish_plug(&plug);
+		writecache_writeback_submit(wc, &wbl);
 
 	if (unlikely(wc->writeback_all)) {
 		wc_lock(wc);
@@ -1846,6 +2019,11 @@ static void writecache_dtr(struct dm_target *ti)
 	if (wc->writeback_wq)
 		destroy_workqueue(wc->writeback_wq);
 
+	if (wc->writeback_submit_wq)
+		destroy_workqueue(wc->writeback_submit_wq);
+
+	kfree(wc->writeback_thread);
+
 	if (wc->dev)
 		dm_put_device(ti, wc->dev);
 
@@ -1889,7 +2067,7 @@ static int writecache_ctr(struct dm_target *ti, unsigned argc, char **argv)
 	struct wc_memory_superblock s;
 
 	static struct dm_arg _args[] = {
-		{0, 10, "Invalid number of feature args"},
+		{0, 16, "Invalid number of feature args"},
 	};
 
 	as.argc = argc;
@@ -2033,6 +2211,7 @@ static int writecache_ctr(struct dm_target *ti, unsigned argc, char **argv)
 	wc->block_size_bits = __ffs(wc->block_size);
 
 	wc->max_writeback_jobs = MAX_WRITEBACK_JOBS;
+	wc->writeback_threads = 1;
 	wc->autocommit_blocks = !WC_MODE_PMEM(wc) ? AUTOCOMMIT_BLOCKS_SSD : AUTOCOMMIT_BLOCKS_PMEM;
 	wc->autocommit_jiffies = msecs_to_jiffies(AUTOCOMMIT_MSEC);
 
@@ -2073,6 +2252,15 @@ static int writecache_ctr(struct dm_target *ti, unsigned argc, char **argv)
 			if (sscanf(string, "%u%c", &wc->max_writeback_jobs, &dummy) != 1)
 				goto invalid_optional;
 			wc->max_writeback_jobs_set = true;
+		} else if (!strcasecmp(string, "writeback_threads") && opt_params >= 1) {
+			string = dm_shift_arg(&as), opt_params--;
+			if (sscanf(string, "%u%c", &wc->writeback_threads, &dummy) != 1)
+				goto invalid_optional;
+			if (!wc->writeback_threads || wc->writeback_threads > WRITEBACK_MAX_THREADS)
+				goto invalid_optional;
+			wc->writeback_threads_set = true;
+		} else if (!strcasecmp(string, "adaptive_watermarks")) {
+			wc->adaptive_watermarks = true;
 		} else if (!strcasecmp(string, "autocommit_blocks") && opt_params >= 1) {
 			string = dm_shift_arg(&as), opt_params--;
 			if (sscanf(string, "%u%c", &wc->autocommit_blocks, &dummy) != 1)
@@ -2111,6 +2299,23 @@ static int writecache_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		goto bad;
 	}
 
+	if (wc->writeback_threads > 1) {
+		wc->writeback_submit_wq = alloc_workqueue("writecache-submit",
+							  WQ_MEM_RECLAIM | WQ_UNBOUND,
+							  wc->writeback_threads - 1);
+		wc->writeback_thread = kcalloc(wc->writeback_threads,
+					       sizeof(struct writeback_thread), GFP_KERNEL);
+		if (!wc->writeback_submit_wq || !wc->writeback_thread) {
+			r = -ENOMEM;
+			ti->error = "Could not allocate writeback threads";
+			goto bad;
+		}
+		for (i = 0; i < wc->writeback_threads; i++) {
+			INIT_WORK(&wc->writeback_thread[i].work, writecache_writeback_thread);
+			wc->writeback_thread[i].wc = wc;
+		}
+	}
+
 	if (WC_MODE_PMEM(wc)) {
 		if (!dax_synchronous(wc->ssd_dev->dax_dev)) {
 			r = -EOPNOTSUPP;
@@ -2257,6 +2462,7 @@ static int writecache_ctr(struct dm_target *ti, unsigned argc, char **argv)
 	x += 50;
 	do_div(x, 100);
 	wc->freelist_low_watermark = x;
+	wc->watermark_adapt_jiffies = jiffies;
 
 	r = writecache_alloc_entries(wc);
 	if (r) {
@@ -2291,9 +2497,20 @@ static void writecache_status(struct dm_target *ti, status_type_t type,
 
 	switch (type) {
 	case STATUSTYPE_INFO:
-		DMEMIT("%ld %llu %llu %llu", writecache_has_error(wc),
+		DMEMIT("%ld %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu",
+		       writecache_has_error(wc),
 		       (unsigned long long)wc->n_blocks, (unsigned long long)wc->freelist_size,
-		       (unsigned long long)wc->writeback_size);
+		       (unsigned long long)wc->writeback_size,
+		       wc->stats.reads,
+		       wc->stats.read_hits,
+		       wc->stats.writes,
+		       wc->stats.write_hits_uncommitted,
+		       wc->stats.write_hits_committed,
+		       wc->stats.writes_allocate,
+		       wc->stats.writes_blocked_on_freelist,
+		       div_u64(wc->stats.freelist_wait_jiffies * 1000, HZ),
+		       wc->stats.flushes,
+		       wc->stats.discards);
 		break;
 	case STATUSTYPE_TABLE:
 		DMEMIT("%c %s %s %u ", WC_MODE_PMEM(wc) ? 'p' : 's',
@@ -2307,6 +2524,10 @@ static void writecache_status(struct dm_target *ti, status_type_t type,
 			extra_args += 2;
 		if (wc->max_writeback_jobs_set)
 			extra_args += 2;
+		if (wc->writeback_threads_set)
+			extra_args += 2;
+		if (wc->adaptive_watermarks)
+			extra_args++;
 		if (wc->autocommit_blocks_set)
 			extra_args += 2;
 		if (wc->autocommit_time_set)
@@ -2331,6 +2552,10 @@ static void writecache_status(struct dm_target *ti, status_type_t type,
 		}
 		if (wc->max_writeback_jobs_set)
 			DMEMIT(" writeback_jobs %u", wc->max_writeback_jobs);
+		if (wc->writeback_threads_set)
+			DMEMIT(" writeback_threads %u", wc->writeback_threads);
+		if (wc->adaptive_watermarks)
+			DMEMIT(" adaptive_watermarks");
 		if (wc->autocommit_blocks_set)
 			DMEMIT(" autocommit_blocks %u", wc->autocommit_blocks);
 		if (wc->autocommit_time_set)
@@ -2343,7 +2568,7 @@ static void writecache_status(struct dm_target *ti, status_type_t type,
 
 static struct target_type writecache_target = {
 	.name			= "writecache",
-	.version		= {1, 1, 1},
+	.version		= {1, 2, 0},
 	.module			= THIS_MODULE,
 	.ctr			= writecache_ctr,
 	.dtr			= writecache_dtr,
@@ -5213,6 +5213,7 @@ static int raid5_read_one_chunk(struct mddev *mddev, struct bio *raid_bio)
 	struct bio* align_bi;
 	struct md_rdev *rdev;
 	sector_t end_sector;
+	bool did_inc;
 
 	if (!in_chunk_boundary(mddev, raid_bio)) {
 		pr_debug("%s: non aligned\n", __func__);
@@ -5276,12 +5277,31 @@ static int raid5_read_one_chunk(struct mddev *mddev, struct bio *raid_bio)
 		/* No reshape active, so we can trust rdev->data_offset */
 		align_bi->bi_iter.bi_sector += rdev->data_offset;
 
-		spin_lock_irq(&conf->device_lock);
-		wait_event_lock_irq(conf->wait_for_quiescent,
-				    conf->quiesce == 0,
-				    conf->device_lock);
-		atomic_inc(&conf->active_aligned_reads);
-		spin_unlock_irq(&conf->device_lock);
+		/*
+		 * Register the read without device_lock, which every aligned
+		 * read would otherwise bounce between CPUs. raid5_quiesce()
+		 * publishes quiesce before waiting for active_aligned_reads,
+		 * so if it is still clear after the increment, quiesce will
+		 * wait for us.
+		 */
+		did_inc = false;
+		if (conf->quiesce == 0) {
+			atomic_inc(&conf->active_aligned_reads);
+			smp_mb__after_atomic();
+			did_inc = true;
+		}
+		if (!did_inc || READ_ONCE(conf->quiesce) != 0) {
+			/* Quiesce in progress, back off and wait for it */
+			if (did_inc &&
+			    atomic_dec_and_test(&conf->active_aligned_reads))
+				wake_up(&conf->wait_for_quiescent);
+			spin_lock_irq(&conf->device_lock);
+			wait_event_lock_irq(conf->wait_for_quiescent,
+					    conf->quiesce == 0,
+					    conf->device_lock);
+			atomic_inc(&conf->active_aligned_reads);
+			spin_unlock_irq(&conf->device_lock);
+		}
 
 		if (mddev->gendisk)
 			trace_block_bio_remap(align_bi->bi_disk->queue,
@@ -8081,7 +8101,8 @@ static void raid5_quiesce(struct mddev *mddev, int quiesce)
 		 * active stripes can drain
 		 */
 		r5c_flush_cache(conf, INT_MAX);
-		conf->quiesce = 2;
+		/* pairs with smp_mb__after_atomic() in raid5_read_one_chunk() */
+		smp_store_mb(conf->quiesce, 2);
 		wait_event_cmd(conf->wait_for_quiescent,
 				    atomic_read(&conf->active_stripes) == 0 &&
 				    atomic_read(&conf->active_aligned_reads) == 0,
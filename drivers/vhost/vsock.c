@@ -28,6 +28,8 @@
  * small pkts.
  */
 #define VHOST_VSOCK_PKT_WEIGHT 256
+/* Max number of packets handed to the vsock core at once */
+#define VHOST_VSOCK_PKT_BATCH 16
 
 enum {
 	VHOST_VSOCK_FEATURES = VHOST_FEATURES,
@@ -434,9 +436,10 @@ static void vhost_vsock_handle_tx_kick(struct vhost_work *work)
 	struct vhost_vsock *vsock = container_of(vq->dev, struct vhost_vsock,
 						 dev);
 	struct virtio_vsock_pkt *pkt;
-	int head, pkts = 0, total_len = 0;
+	int head, pkts = 0, total_len = 0, batched = 0;
 	unsigned int out, in;
 	bool added = false;
+	LIST_HEAD(batch);
 
 	mutex_lock(&vq->mutex);
 
@@ -482,10 +485,16 @@ static void vhost_vsock_handle_tx_kick(struct vhost_work *work)
 		/* Only accept correctly addressed packets */
 		if (le64_to_cpu(pkt->hdr.src_cid) == vsock->guest_cid &&
 		    le64_to_cpu(pkt->hdr.dst_cid) ==
-		    vhost_transport_get_local_cid())
-			virtio_transport_recv_pkt(&vhost_transport, pkt);
-		else
+		    vhost_transport_get_local_cid()) {
+			list_add_tail(&pkt->list, &batch);
+			if (++batched == VHOST_VSOCK_PKT_BATCH) {
+				virtio_transport_recv_pkt_list(&vhost_transport,
+							       &batch);
+				batched = 0;
+			}
+		} else {
 			virtio_transport_free_pkt(pkt);
+		}
 
 		len += sizeof(pkt->hdr);
 		vhost_add_used(vq, head, len);
@@ -494,6 +503,7 @@ static void vhost_vsock_handle_tx_kick(struct vhost_work *work)
 	} while(likely(!vhost_exceeds_weight(vq, ++pkts, total_len)));
 
 no_more_replies:
+	virtio_transport_recv_pkt_list(&vhost_transport, &batch);
 	if (added)
 		vhost_signal(&vsock->dev, vq);
 
@@ -379,7 +379,8 @@ EXPORT_SYMBOL(fput);
 void __init files_init(void)
 {
 	filp_cachep = kmem_cache_create("filp", sizeof(struct file), 0,
-			SLAB_HWCACHE_ALIGN | SLAB_PANIC | SLAB_ACCOUNT, NULL);
+			SLAB_HWCACHE_ALIGN | SLAB_PANIC | SLAB_ACCOUNT |
+			SLAB_SHEAVES, NULL);
 	percpu_counter_init(&nr_files, 0, GFP_KERNEL);
 }
 
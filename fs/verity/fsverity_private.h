@@ -15,6 +15,7 @@
 #define pr_fmt(fmt) "fs-verity: " fmt
 
 #include <crypto/sha.h>
+#include <linux/crypto.h>
 #include <linux/fsverity.h>
 #include <linux/mempool.h>
 
@@ -39,6 +40,7 @@ struct fsverity_hash_alg {
 	unsigned int digest_size; /* digest size in bytes, e.g. 32 for SHA-256 */
 	unsigned int block_size;  /* block size in bytes, e.g. 64 for SHA-256 */
 	mempool_t req_pool;	  /* mempool with a preallocated hash request */
+	struct crypto_req_cache req_cache; /* per-CPU spare hash requests */
 };
 
 /* Merkle tree parameters: hash algorithm, initial hash state, and topology */
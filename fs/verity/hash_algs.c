@@ -93,6 +93,12 @@ struct fsverity_hash_alg *fsverity_get_hash_alg(const struct inode *inode,
 	if (err)
 		goto err_free_tfm;
 
+	err = crypto_req_cache_init(&alg->req_cache,
+				    sizeof(struct ahash_request) +
+				    crypto_ahash_reqsize(tfm));
+	if (err)
+		goto err_exit_pool;
+
 	pr_info("%s using implementation \"%s\"\n",
 		alg->name, crypto_ahash_driver_name(tfm));
 
@@ -100,6 +106,8 @@ struct fsverity_hash_alg *fsverity_get_hash_alg(const struct inode *inode,
 	smp_store_release(&alg->tfm, tfm);
 	goto out_unlock;
 
+err_exit_pool:
+	mempool_exit(&alg->req_pool);
 err_free_tfm:
 	crypto_free_ahash(tfm);
 	alg = ERR_PTR(err);
@@ -113,17 +121,22 @@ struct fsverity_hash_alg *fsverity_get_hash_alg(const struct inode *inode,
  * @alg: the hash algorithm for which to allocate the request
  * @gfp_flags: memory allocation flags
  *
- * This is mempool-backed, so this never fails if __GFP_DIRECT_RECLAIM is set in
- * @gfp_flags.  However, in that case this might need to wait for all
- * previously-allocated requests to be freed.  So to avoid deadlocks, callers
- * must never need multiple requests at a time to make forward progress.
+ * The current CPU's spare request is used if there is one, so normally this
+ * doesn't allocate memory at all.  Otherwise this is mempool-backed, so this
+ * never fails if __GFP_DIRECT_RECLAIM is set in @gfp_flags.  However, in that
+ * case this might need to wait for all previously-allocated requests to be
+ * freed.  So to avoid deadlocks, callers must never need multiple requests at a
+ * time to make forward progress.
  *
  * Return: the request object on success; NULL on failure (but see above)
  */
 struct ahash_request *fsverity_alloc_hash_request(struct fsverity_hash_alg *alg,
 						  gfp_t gfp_flags)
 {
-	struct ahash_request *req = mempool_alloc(&alg->req_pool, gfp_flags);
+	struct ahash_request *req = crypto_req_cache_get(&alg->req_cache);
+
+	if (!req)
+		req = mempool_alloc(&alg->req_pool, gfp_flags);
 
 	if (req)
 		ahash_request_set_tfm(req, alg->tfm);
@@ -140,6 +153,13 @@ void fsverity_free_hash_request(struct fsverity_hash_alg *alg,
 {
 	if (req) {
 		ahash_request_zero(req);
+		/*
+		 * Refill the mempool's reserve first, since someone may be
+		 * waiting for it.
+		 */
+		if (READ_ONCE(alg->req_pool.curr_nr) >= alg->req_pool.min_nr &&
+		    crypto_req_cache_put(&alg->req_cache, req))
+			return;
 		mempool_free(req, &alg->req_pool);
 	}
 }
@@ -66,6 +66,25 @@ static inline int cmp_hashes(const struct fsverity_info *vi,
 	return -EBADMSG;
 }
 
+/*
+ * A verified level 0 hash page, kept referenced across the data pages of a bio.
+ * Consecutive data pages are mostly covered by the same hash page, and while
+ * we hold it, it can be used without looking it up or hashing it again.
+ */
+struct level0_cache {
+	struct page *hpage;
+	pgoff_t hindex;
+};
+
+static void level0_cache_set(struct level0_cache *cache, struct page *hpage,
+			     pgoff_t hindex)
+{
+	if (cache->hpage)
+		put_page(cache->hpage);
+	cache->hpage = hpage;
+	cache->hindex = hindex;
+}
+
 /*
  * Verify a single data page against the file's Merkle tree.
  *
@@ -81,11 +100,14 @@ static inline int cmp_hashes(const struct fsverity_info *vi,
  * Note that multiple processes may race to verify a hash page and mark it
  * Checked, but it doesn't matter; the result will be the same either way.
  *
+ * If @cache is given, the verified level 0 hash page is left in it for the next
+ * data page rather than released, and is used directly if it covers this page.
+ *
  * Return: true if the page is valid, else false.
  */
 static bool verify_page(struct inode *inode, const struct fsverity_info *vi,
 			struct ahash_request *req, struct page *data_page,
-			unsigned long level0_ra_pages)
+			unsigned long level0_ra_pages, struct level0_cache *cache)
 {
 	const struct merkle_tree_params *params = &vi->tree_params;
 	const unsigned int hsize = params->digest_size;
@@ -96,6 +118,7 @@ static bool verify_page(struct inode *inode, const struct fsverity_info *vi,
 	u8 real_hash[FS_VERITY_MAX_DIGEST_SIZE];
 	struct page *hpages[FS_VERITY_MAX_LEVELS];
 	unsigned int hoffsets[FS_VERITY_MAX_LEVELS];
+	pgoff_t hindex0 = 0;
 	int err;
 
 	if (WARN_ON_ONCE(!PageLocked(data_page) || PageUptodate(data_page)))
@@ -103,6 +126,19 @@ static bool verify_page(struct inode *inode, const struct fsverity_info *vi,
 
 	pr_debug_ratelimited("Verifying data page %lu...\n", index);
 
+	if (cache && cache->hpage) {
+		pgoff_t hindex;
+		unsigned int hoffset;
+
+		hash_at_level(params, index, 0, &hindex, &hoffset);
+		if (hindex == cache->hindex) {
+			extract_hash(cache->hpage, hoffset, hsize, _want_hash);
+			want_hash = _want_hash;
+			level = 0;
+			goto descend;
+		}
+	}
+
 	/*
 	 * Starting at the leaf level, ascend the tree saving hash pages along
 	 * the way until we find a verified hash page, indicated by PageChecked;
@@ -131,7 +167,10 @@ static bool verify_page(struct inode *inode, const struct fsverity_info *vi,
 		if (PageChecked(hpage)) {
 			extract_hash(hpage, hoffset, hsize, _want_hash);
 			want_hash = _want_hash;
-			put_page(hpage);
+			if (level == 0 && cache)
+				level0_cache_set(cache, hpage, hindex);
+			else
+				put_page(hpage);
 			pr_debug_ratelimited("Hash page already checked, want %s:%*phN\n",
 					     params->hash_alg->name,
 					     hsize, want_hash);
@@ -140,6 +179,8 @@ static bool verify_page(struct inode *inode, const struct fsverity_info *vi,
 		pr_debug_ratelimited("Hash page not yet checked\n");
 		hpages[level] = hpage;
 		hoffsets[level] = hoffset;
+		if (level == 0)
+			hindex0 = hindex;
 	}
 
 	want_hash = vi->root_hash;
@@ -160,7 +201,10 @@ static bool verify_page(struct inode *inode, const struct fsverity_info *vi,
 		SetPageChecked(hpage);
 		extract_hash(hpage, hoffset, hsize, _want_hash);
 		want_hash = _want_hash;
-		put_page(hpage);
+		if (level == 1 && cache)
+			level0_cache_set(cache, hpage, hindex0);
+		else
+			put_page(hpage);
 		pr_debug("Verified hash page at level %d, now want %s:%*phN\n",
 			 level - 1, params->hash_alg->name, hsize, want_hash);
 	}
@@ -195,7 +239,7 @@ bool fsverity_verify_page(struct page *page)
 	/* This allocation never fails, since it's mempool-backed. */
 	req = fsverity_alloc_hash_request(vi->tree_params.hash_alg, GFP_NOFS);
 
-	valid = verify_page(inode, vi, req, page, 0);
+	valid = verify_page(inode, vi, req, page, 0, NULL);
 
 	fsverity_free_hash_request(vi->tree_params.hash_alg, req);
 
@@ -227,6 +271,7 @@ void fsverity_verify_bio(struct bio *bio)
 	struct bio_vec *bv;
 	struct bvec_iter_all iter_all;
 	unsigned long max_ra_pages = 0;
+	struct level0_cache cache = { NULL };
 
 	/* This allocation never fails, since it's mempool-backed. */
 	req = fsverity_alloc_hash_request(params->hash_alg, GFP_NOFS);
@@ -253,10 +298,12 @@ void fsverity_verify_bio(struct bio *bio)
 			min(max_ra_pages, params->level0_blocks - level0_index);
 
 		if (!PageError(page) &&
-		    !verify_page(inode, vi, req, page, level0_ra_pages))
+		    !verify_page(inode, vi, req, page, level0_ra_pages, &cache))
 			SetPageError(page);
 	}
 
+	if (cache.hpage)
+		put_page(cache.hpage);
 	fsverity_free_hash_request(params->hash_alg, req);
 }
 EXPORT_SYMBOL_GPL(fsverity_verify_bio);
@@ -696,6 +696,25 @@ static inline void crypto_init_wait(struct crypto_wait *wait)
 	init_completion(&wait->completion);
 }
 
+/*
+ * Per-CPU cache of request buffers for users that need a request (plus
+ * private data) for every packet or bio. Each CPU holds one spare buffer
+ * of at least @size bytes which is taken and given back without locking;
+ * larger requests and misses fall back to kmalloc().
+ */
+struct crypto_req_cache {
+	void * __percpu *spare;
+	unsigned int size;
+};
+
+int crypto_req_cache_init(struct crypto_req_cache *cache, unsigned int size);
+void crypto_req_cache_destroy(struct crypto_req_cache *cache);
+void *crypto_req_cache_get(struct crypto_req_cache *cache);
+bool crypto_req_cache_put(struct crypto_req_cache *cache, void *req);
+void *crypto_req_cache_alloc(struct crypto_req_cache *cache, unsigned int len,
+			     gfp_t gfp);
+void crypto_req_cache_free(struct crypto_req_cache *cache, void *req);
+
 /*
  * Algorithm registration interface.
  */
@@ -93,6 +93,13 @@
 /* Avoid kmemleak tracing */
 #define SLAB_NOLEAKTRACE	((slab_flags_t __force)0x00800000U)
 
+/* Batch alloc/free through per cpu arrays of objects (sheaves) */
+#ifdef CONFIG_SLUB
+# define SLAB_SHEAVES		((slab_flags_t __force)0x01000000U)
+#else
+# define SLAB_SHEAVES		0
+#endif
+
 /* Fault injection mark */
 #ifdef CONFIG_FAILSLAB
 # define SLAB_FAILSLAB		((slab_flags_t __force)0x02000000U)
@@ -191,6 +198,15 @@ void kzfree(const void *);
 size_t __ksize(const void *);
 size_t ksize(const void *);
 
+#ifdef CONFIG_SLUB
+bool kfree_rcu_sheaf(void *obj);
+#else
+static inline bool kfree_rcu_sheaf(void *obj)
+{
+	return false;
+}
+#endif
+
 #ifdef CONFIG_HAVE_HARDENED_USERCOPY_ALLOCATOR
 void __check_heap_object(const void *ptr, unsigned long n, struct page *page,
 			bool to_user);
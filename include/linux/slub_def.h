@@ -36,6 +36,11 @@ enum stat_item {
 	CPU_PARTIAL_FREE,	/* Refill cpu partial on free */
 	CPU_PARTIAL_NODE,	/* Refill cpu partial from node partial */
 	CPU_PARTIAL_DRAIN,	/* Drain cpu partial to node partial */
+	SHEAF_ALLOC,		/* Allocation from cpu sheaf */
+	SHEAF_FREE,		/* Free to cpu sheaf */
+	SHEAF_REFILL,		/* Refill sheaf from cpu slab and partials */
+	SHEAF_FLUSH,		/* Flush sheaf back to slabs */
+	SHEAF_RCU,		/* kfree_rcu() batched in rcu sheaf */
 	NR_SLUB_STAT_ITEMS };
 
 struct kmem_cache_cpu {
@@ -67,6 +72,25 @@ struct kmem_cache_cpu {
 #define slub_percpu_partial_read_once(c)	NULL
 #endif // CONFIG_SLUB_CPU_PARTIAL
 
+/*
+ * Array of free objects for caches created with SLAB_SHEAVES. Each cpu
+ * allocates from and frees to its main sheaf, the spare one is swapped in
+ * when main runs empty or full so that the slabs are only touched once
+ * per sheaf_capacity objects.
+ */
+struct slab_sheaf {
+	struct rcu_head rcu_head;
+	struct kmem_cache *cache;
+	unsigned int size;
+	void *objects[];
+};
+
+struct slub_percpu_sheaves {
+	struct slab_sheaf *main;	/* Never NULL */
+	struct slab_sheaf *spare;	/* Never NULL */
+	struct slab_sheaf *rcu_free;	/* Objects waiting for kfree_rcu() */
+};
+
 /*
  * Word size structure that can be atomically updated or read and that
  * contains both the order and the number of objects that a slab of the
@@ -91,6 +115,9 @@ struct kmem_cache {
 	/* Number of per cpu partial objects to keep around */
 	unsigned int cpu_partial;
 #endif
+	/* Objects per sheaf, zero unless SLAB_SHEAVES */
+	unsigned int sheaf_capacity;
+	struct slub_percpu_sheaves __percpu *cpu_sheaves;
 	struct kmem_cache_order_objects oo;
 
 	/* Allocation and freeing of slabs */
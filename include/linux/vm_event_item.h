@@ -109,6 +109,13 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 #ifdef CONFIG_SWAP
 		SWAP_RA,
 		SWAP_RA_HIT,
+#endif
+#ifdef CONFIG_MMU
+		VMALLOC_HUGE,		/* vmalloc area backed by PMD pages */
+		VMALLOC_HUGE_FALLBACK,	/* retried with base pages */
+		VMAP_PURGE,		/* lazy purge passes, one TLB flush each */
+		VMAP_PURGE_AREAS,
+		VMAP_PURGE_PAGES,
 #endif
 		NR_VM_EVENT_ITEMS
 };
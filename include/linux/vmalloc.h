@@ -27,6 +27,7 @@ struct notifier_block;		/* in notifier.h */
  * vfree_atomic().
  */
 #define VM_FLUSH_RESET_PERMS	0x00000100      /* Reset direct map and flush TLB on unmap */
+#define VM_ALLOW_HUGE_VMAP	0x00000200      /* Allow PMD mappings, see vmalloc_huge() */
 
 /* bits [20..32] reserved for arch specific ioremap internals */
 
@@ -45,6 +46,7 @@ struct vm_struct {
 	unsigned long		flags;
 	struct page		**pages;
 	unsigned int		nr_pages;
+	unsigned int		page_order;	/* Order of the backing pages */
 	phys_addr_t		phys_addr;
 	const void		*caller;
 };
@@ -96,6 +98,10 @@ extern void *vzalloc_node(unsigned long size, int node);
 extern void *vmalloc_exec(unsigned long size);
 extern void *vmalloc_32(unsigned long size);
 extern void *vmalloc_32_user(unsigned long size);
+extern void *vmalloc_huge(unsigned long size, gfp_t gfp_mask);
+extern void *vmalloc_huge_node(unsigned long size, gfp_t gfp_mask, int node);
+extern void *vmalloc_huge_node_caller(unsigned long size, gfp_t gfp_mask,
+				      int node, const void *caller);
 extern void *__vmalloc(unsigned long size, gfp_t gfp_mask, pgprot_t prot);
 extern void *__vmalloc_node_range(unsigned long size, unsigned long align,
 			unsigned long start, unsigned long end, gfp_t gfp_mask,
@@ -29,6 +29,7 @@
 #include <net/netns/conntrack.h>
 #endif
 #include <net/netns/nftables.h>
+#include <net/netns/flow_table.h>
 #include <net/netns/xfrm.h>
 #include <net/netns/mpls.h>
 #include <net/netns/can.h>
@@ -141,6 +142,9 @@ struct net {
 #if defined(CONFIG_NF_TABLES) || defined(CONFIG_NF_TABLES_MODULE)
 	struct netns_nftables	nft;
 #endif
+#if IS_ENABLED(CONFIG_NF_FLOW_TABLE)
+	struct netns_ft		ft;
+#endif
 #if IS_ENABLED(CONFIG_NF_DEFRAG_IPV6)
 	struct netns_nf_frag	nf_frag;
 	struct ctl_table_header *nf_frag_frags_hdr;
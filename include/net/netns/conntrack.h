@@ -92,6 +92,14 @@ struct ct_pcpu {
 	struct hlist_nulls_head dying;
 };
 
+/* Table maintenance counters, see /proc/net/stat/nf_conntrack_gc */
+struct ct_pcpu_gc_stat {
+	unsigned int		lock_retry;	/* table resized while locking */
+	unsigned int		gc_scanned;
+	unsigned int		gc_expired;
+	unsigned int		gc_lag;		/* msecs past timeout, summed */
+};
+
 struct netns_ct {
 	atomic_t		count;
 	unsigned int		expect_count;
@@ -112,6 +120,7 @@ struct netns_ct {
 
 	struct ct_pcpu __percpu *pcpu_lists;
 	struct ip_conntrack_stat __percpu *stat;
+	struct ct_pcpu_gc_stat __percpu *gc_stat;
 	struct nf_ct_event_notifier __rcu *nf_conntrack_event_cb;
 	struct nf_exp_event_notifier __rcu *nf_expect_event_cb;
 	struct nf_ip_net	nf_ct_proto;
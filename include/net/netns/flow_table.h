@@ -0,0 +1,17 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _NETNS_FLOW_TABLE_H_
+#define _NETNS_FLOW_TABLE_H_
+
+struct nf_flow_table_stat {
+	unsigned int found;
+	unsigned int miss;
+	unsigned int slowpath;
+	unsigned int xmit_neigh;
+	unsigned int xmit_direct;
+};
+
+struct netns_ft {
+	struct nf_flow_table_stat __percpu *stat;
+};
+
+#endif
@@ -38,6 +38,7 @@ struct nh_config {
 
 	struct nlattr	*nh_grp;
 	u16		nh_grp_type;
+	u16		nh_grp_res_num_buckets;
 
 	struct nlattr	*nh_encap;
 	u16		nh_encap_type;
@@ -65,14 +66,29 @@ struct nh_grp_entry {
 	u8		weight;
 	atomic_t	upper_bound;
 
+	/* resilient groups: buckets wanted and held, rtnl only */
+	u16		res_wants;
+	u16		res_count;
+
 	struct list_head nh_list;
 	struct nexthop	*nh_parent;  /* nexthop of group with this entry */
 };
 
+/* Bucket table of a resilient group. A flow hashes to a bucket and
+ * keeps its nexthop for as long as that nexthop stays in the group,
+ * only the buckets of a removed or overweight member are reassigned.
+ */
+struct nh_res_table {
+	u16			num_nh_buckets;
+	struct nexthop		*nh_buckets[0];
+};
+
 struct nh_group {
 	struct nh_group		*spare; /* spare group for removals */
+	struct nh_res_table	*res_table;
 	u16			num_nh;
 	bool			mpath;
+	bool			resilient;
 	bool			has_v4;
 	struct nh_grp_entry	nh_entries[0];
 };
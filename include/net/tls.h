@@ -136,6 +136,7 @@ struct tls_rec {
 
 	char aad_space[TLS_AAD_SPACE_SIZE];
 	u8 iv_data[MAX_IV_SIZE];
+	struct work_struct encrypt_work;
 	struct aead_request aead_req;
 	u8 aead_req_ctx[];
 };
@@ -161,6 +162,12 @@ struct tls_sw_context_tx {
 	spinlock_t encrypt_compl_lock;
 	int async_notify;
 	int async_capable;
+	/* Encrypt on system_unbound_wq rather than in the sender */
+	bool crypto_offload;
+	/* The open record is held back until coalesce_deadline */
+	bool open_rec_held;
+	u32 coalesce_us;
+	unsigned long coalesce_deadline;
 
 #define BIT_TX_SCHEDULED	0
 #define BIT_TX_CLOSING		1
@@ -178,6 +185,8 @@ struct tls_sw_context_rx {
 	u8 control;
 	int async_capable;
 	bool decrypted;
+	/* TLS 1.3 content type of a record decrypted into user pages */
+	u8 tail;
 	atomic_t decrypt_pending;
 	/* protect crypto_wait with decrypt_pending*/
 	spinlock_t decrypt_compl_lock;
@@ -255,6 +264,8 @@ struct tls_context {
 
 	u8 tx_conf:3;
 	u8 rx_conf:3;
+	/* TLS 1.3: decrypt straight into user pages, hoping for no padding */
+	u8 rx_no_pad:1;
 
 	int (*push_pending_record)(struct sock *sk, int flags);
 	void (*sk_write_space)(struct sock *sk);
@@ -287,6 +298,11 @@ struct tls_context {
 	union tls_crypto_context crypto_send;
 	union tls_crypto_context crypto_recv;
 
+	/* TX statistics, reported through sock_diag */
+	u64 tx_records;
+	u64 tx_async_records;
+	u64 tx_coalesced;
+
 	struct list_head list;
 	refcount_t refcount;
 	struct rcu_head rcu;
@@ -39,6 +39,9 @@
 /* TLS socket options */
 #define TLS_TX			1	/* Set transmit parameters */
 #define TLS_RX			2	/* Set receive parameters */
+#define TLS_TX_ASYNC		3	/* Encrypt TX records on worker threads */
+#define TLS_TX_COALESCE		4	/* Hold partial TX records, in usecs */
+#define TLS_RX_EXPECT_NO_PAD	5	/* TLS 1.3: Expect no padding from peer */
 
 /* Supported versions */
 #define TLS_VERSION_MINOR(ver)	((ver) & 0xFF)
@@ -115,6 +118,10 @@ enum {
 	TLS_INFO_CIPHER,
 	TLS_INFO_TXCONF,
 	TLS_INFO_RXCONF,
+	TLS_INFO_TX_RECORDS,
+	TLS_INFO_TX_ASYNC_RECORDS,
+	TLS_INFO_TX_COALESCED,
+	TLS_INFO_RX_NO_PAD,
 	__TLS_INFO_MAX,
 };
 #define TLS_INFO_MAX (__TLS_INFO_MAX - 1)
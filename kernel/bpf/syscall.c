@@ -151,9 +151,10 @@ void *bpf_map_area_alloc(u64 size, int numa_node)
 			return area;
 	}
 
-	return __vmalloc_node_flags_caller(size, numa_node,
-					   GFP_KERNEL | __GFP_RETRY_MAYFAIL |
-					   flags, __builtin_return_address(0));
+	/* Large maps are hot in the TLB, let them use PMD mappings */
+	return vmalloc_huge_node_caller(size,
+					GFP_KERNEL | __GFP_RETRY_MAYFAIL | flags,
+					numa_node, __builtin_return_address(0));
 }
 
 void bpf_map_area_free(void *area)
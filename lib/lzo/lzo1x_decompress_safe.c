@@ -36,6 +36,15 @@
  */
 #define MAX_255_COUNT      ((((size_t)~0) / 255) - 2)
 
+#if defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS)
+/* Source adjustments turning a match distance below 8 into one of 8 or more
+ * that is a multiple of the original distance, indexed by that distance.
+ * See the overlapping match copy below.
+ */
+static const unsigned char lzo_widen_inc[8] = { 0, 1, 2, 1, 0, 4, 4, 4 };
+static const signed char lzo_widen_dec[8] = { 0, 0, 0, -1, -4, 1, 2, 3 };
+#endif
+
 int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
 			  unsigned char *out, size_t *out_len)
 {
@@ -236,6 +245,36 @@ int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
 					*op++ = *m_pos++;
 				} while (op < oe);
 			}
+		} else if (likely(HAVE_OP(t + 15))) {
+			/*
+			 * Overlapping match of a short pattern (run lengths
+			 * and the like). Widen the distance to at least 8
+			 * with the first 8 bytes, then copy 8 bytes at a time.
+			 */
+			size_t dist = op - m_pos;
+			unsigned char *oe = op + t;
+
+			op[0] = m_pos[0];
+			op[1] = m_pos[1];
+			op[2] = m_pos[2];
+			op[3] = m_pos[3];
+			m_pos += lzo_widen_inc[dist];
+			COPY4(op + 4, m_pos);
+			m_pos -= lzo_widen_dec[dist];
+			op += 8;
+			while (op < oe) {
+				COPY8(op, m_pos);
+				op += 8;
+				m_pos += 8;
+			}
+			op = oe;
+			if (HAVE_IP(6)) {
+				state = next;
+				COPY4(op, ip);
+				op += next;
+				ip += next;
+				continue;
+			}
 		} else
 #endif
 		{
@@ -327,6 +327,24 @@ void *vmalloc_32_user(unsigned long size)
 }
 EXPORT_SYMBOL(vmalloc_32_user);
 
+void *vmalloc_huge(unsigned long size, gfp_t gfp_mask)
+{
+	return __vmalloc(size, gfp_mask, PAGE_KERNEL);
+}
+EXPORT_SYMBOL_GPL(vmalloc_huge);
+
+void *vmalloc_huge_node(unsigned long size, gfp_t gfp_mask, int node)
+{
+	return __vmalloc(size, gfp_mask, PAGE_KERNEL);
+}
+EXPORT_SYMBOL_GPL(vmalloc_huge_node);
+
+void *vmalloc_huge_node_caller(unsigned long size, gfp_t gfp_mask, int node,
+			       const void *caller)
+{
+	return __vmalloc(size, gfp_mask, PAGE_KERNEL);
+}
+
 void *vmap(struct page **pages, unsigned int count, unsigned long flags, pgprot_t prot)
 {
 	BUG();
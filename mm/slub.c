@@ -226,6 +226,12 @@ static inline void memcg_propagate_slab_attrs(struct kmem_cache *s) { }
 static inline void sysfs_slab_remove(struct kmem_cache *s) { }
 #endif
 
+static void *alloc_from_sheaf(struct kmem_cache *s, gfp_t gfp);
+static bool free_to_sheaf(struct kmem_cache *s, struct page *page,
+			  void *object);
+static void flush_cpu_sheaves(struct kmem_cache *s, int cpu);
+static void submit_rcu_sheaf(struct kmem_cache *s, int cpu);
+
 static inline void stat(const struct kmem_cache *s, enum stat_item si)
 {
 #ifdef CONFIG_SLUB_STATS
@@ -1453,6 +1459,23 @@ static __always_inline bool slab_free_hook(struct kmem_cache *s, void *x)
 	return kasan_slab_free(s, x, _RET_IP_);
 }
 
+static __always_inline void slab_wipe_on_free(struct kmem_cache *s,
+					      void *object)
+{
+	int rsize;
+
+	if (slab_want_init_on_free(s)) {
+		/*
+		 * Clear the object and the metadata, but don't touch
+		 * the redzone.
+		 */
+		memset(object, 0, s->object_size);
+		rsize = (s->flags & SLAB_RED_ZONE) ? s->red_left_pad : 0;
+		memset((char *)object + s->inuse, 0,
+		       s->size - s->inuse - rsize);
+	}
+}
+
 static inline bool slab_free_freelist_hook(struct kmem_cache *s,
 					   void **head, void **tail)
 {
@@ -1460,7 +1483,6 @@ static inline bool slab_free_freelist_hook(struct kmem_cache *s,
 	void *object;
 	void *next = *head;
 	void *old_tail = *tail ? *tail : *head;
-	int rsize;
 
 	/* Head and tail of the reconstructed freelist */
 	*head = NULL;
@@ -1470,18 +1492,7 @@ static inline bool slab_free_freelist_hook(struct kmem_cache *s,
 		object = next;
 		next = get_freepointer(s, object);
 
-		if (slab_want_init_on_free(s)) {
-			/*
-			 * Clear the object and the metadata, but don't touch
-			 * the redzone.
-			 */
-			memset(object, 0, s->object_size);
-			rsize = (s->flags & SLAB_RED_ZONE) ? s->red_left_pad
-							   : 0;
-			memset((char *)object + s->inuse, 0,
-			       s->size - s->inuse - rsize);
-
-		}
+		slab_wipe_on_free(s, object);
 		/* If object's reuse doesn't have to be delayed */
 		if (!slab_free_hook(s, object)) {
 			/* Move object to the new freelist */
@@ -2352,6 +2363,10 @@ static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 {
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
+	/* Sheaves drain into the cpu slab, so flush them first */
+	if (s->cpu_sheaves)
+		flush_cpu_sheaves(s, cpu);
+
 	if (c->page)
 		flush_slab(s, c);
 
@@ -2370,7 +2385,8 @@ static bool has_cpu_slab(int cpu, void *info)
 	struct kmem_cache *s = info;
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
-	return c->page || slub_percpu_partial(c);
+	/* Sheaves are swapped under the owning cpu, don't peek at them */
+	return c->page || slub_percpu_partial(c) || s->cpu_sheaves;
 }
 
 static void flush_all(struct kmem_cache *s)
@@ -2391,6 +2407,8 @@ static int slub_cpu_dead(unsigned int cpu)
 	list_for_each_entry(s, &slab_caches, list) {
 		local_irq_save(flags);
 		__flush_cpu_slab(s, cpu);
+		if (s->cpu_sheaves)
+			submit_rcu_sheaf(s, cpu);
 		local_irq_restore(flags);
 	}
 	mutex_unlock(&slab_mutex);
@@ -2727,6 +2745,12 @@ static __always_inline void *slab_alloc_node(struct kmem_cache *s,
 	s = slab_pre_alloc_hook(s, gfpflags);
 	if (!s)
 		return NULL;
+
+	if (s->cpu_sheaves && node == NUMA_NO_NODE) {
+		object = alloc_from_sheaf(s, gfpflags);
+		if (likely(object))
+			goto out;
+	}
 redo:
 	/*
 	 * Must read kmem_cache cpu data via this cpu ptr. Preemption is
@@ -2794,7 +2818,7 @@ static __always_inline void *slab_alloc_node(struct kmem_cache *s,
 		prefetch_freepointer(s, next_object);
 		stat(s, ALLOC_FASTPATH);
 	}
-
+out:
 	maybe_wipe_obj_freeptr(s, object);
 
 	if (unlikely(slab_want_init_on_alloc(gfpflags, s)) && object)
@@ -3048,8 +3072,13 @@ static __always_inline void slab_free(struct kmem_cache *s, struct page *page,
 	 * With KASAN enabled slab_free_freelist_hook modifies the freelist
 	 * to remove objects, whose reuse must be delayed.
 	 */
-	if (slab_free_freelist_hook(s, &head, &tail))
-		do_slab_free(s, page, head, tail, cnt, addr);
+	if (!slab_free_freelist_hook(s, &head, &tail))
+		return;
+
+	if (s->cpu_sheaves && cnt == 1 && free_to_sheaf(s, page, head))
+		return;
+
+	do_slab_free(s, page, head, tail, cnt, addr);
 }
 
 #ifdef CONFIG_KASAN_GENERIC
@@ -3160,6 +3189,349 @@ int build_detached_freelist(struct kmem_cache *s, size_t size,
 	return first_skipped_index;
 }
 
+/*
+ * Per cpu sheaves.
+ *
+ * Caches created with SLAB_SHEAVES keep two arrays of free objects per cpu.
+ * Allocations and frees only touch the main sheaf with interrupts disabled.
+ * When it runs empty it is swapped with the spare or refilled in one go
+ * from the cpu slab and the node partial lists, when it runs full the
+ * spare is flushed back to the slabs in page-sized batches.
+ *
+ * kfree_rcu() of objects from such a cache collects them in a separate
+ * sheaf which goes through a single grace period once full and then
+ * becomes the spare, so the objects are reused without touching the
+ * slabs at all.
+ *
+ * Node specific allocations, pfmemalloc slabs and memcg child caches
+ * bypass the sheaves.
+ */
+static struct slab_sheaf *alloc_empty_sheaf(struct kmem_cache *s, gfp_t gfp)
+{
+	struct slab_sheaf *sheaf;
+
+	sheaf = kzalloc(struct_size(sheaf, objects, s->sheaf_capacity), gfp);
+	if (sheaf)
+		sheaf->cache = s;
+
+	return sheaf;
+}
+
+/*
+ * Return the objects of a sheaf to their slabs.
+ *
+ * Must be called with interrupts disabled.
+ */
+static void sheaf_flush(struct kmem_cache *s, struct slab_sheaf *sheaf)
+{
+	size_t size = sheaf->size;
+
+	if (!size)
+		return;
+
+	stat(s, SHEAF_FLUSH);
+	do {
+		struct detached_freelist df;
+
+		size = build_detached_freelist(s, size, sheaf->objects, &df);
+		if (!df.page)
+			continue;
+
+		do_slab_free(df.s, df.page, df.freelist, df.tail, df.cnt,
+			     _RET_IP_);
+	} while (size);
+
+	sheaf->size = 0;
+}
+
+/*
+ * Fill an empty sheaf from the cpu slab, which is refilled from the
+ * partial lists as needed. Like the bulk allocator this runs with
+ * interrupts disabled, but it must not reenable them, so the refill never
+ * enters direct reclaim or dips into the reserves.
+ */
+static bool sheaf_refill(struct kmem_cache *s, struct slab_sheaf *sheaf,
+			 gfp_t gfp)
+{
+	struct kmem_cache_cpu *c = this_cpu_ptr(s->cpu_slab);
+
+	gfp &= ~__GFP_DIRECT_RECLAIM;
+	gfp |= __GFP_NOMEMALLOC | __GFP_NOWARN;
+
+	while (sheaf->size < s->sheaf_capacity) {
+		void *object = c->freelist;
+
+		if (unlikely(!object)) {
+			/* Same as in kmem_cache_alloc_bulk() */
+			c->tid = next_tid(c->tid);
+
+			object = ___slab_alloc(s, gfp, NUMA_NO_NODE, _RET_IP_, c);
+			if (unlikely(!object))
+				break;
+
+			c = this_cpu_ptr(s->cpu_slab);
+		} else {
+			c->freelist = get_freepointer(s, object);
+		}
+		sheaf->objects[sheaf->size++] = object;
+	}
+	c->tid = next_tid(c->tid);
+
+	stat(s, SHEAF_REFILL);
+	return sheaf->size;
+}
+
+/*
+ * Returns NULL if the sheaves are empty and could not be refilled without
+ * blocking, the regular slow path then deals with the gfp flags.
+ */
+static void *alloc_from_sheaf(struct kmem_cache *s, gfp_t gfp)
+{
+	struct slub_percpu_sheaves *pcs;
+	struct slab_sheaf *sheaf;
+	unsigned long flags;
+	void *object = NULL;
+
+	if (unlikely(kmem_cache_debug(s)))
+		return NULL;
+
+	local_irq_save(flags);
+	pcs = this_cpu_ptr(s->cpu_sheaves);
+	sheaf = pcs->main;
+
+	if (unlikely(!sheaf->size)) {
+		if (pcs->spare->size) {
+			pcs->main = pcs->spare;
+			pcs->spare = sheaf;
+			sheaf = pcs->main;
+		} else if (!sheaf_refill(s, sheaf, gfp)) {
+			goto out;
+		}
+	}
+
+	object = sheaf->objects[--sheaf->size];
+out:
+	local_irq_restore(flags);
+
+	if (object)
+		stat(s, SHEAF_ALLOC);
+	return object;
+}
+
+/*
+ * Free an object that already went through the free hooks. Returns false
+ * if the object has to go back to its slab instead.
+ */
+static bool free_to_sheaf(struct kmem_cache *s, struct page *page,
+			  void *object)
+{
+	struct slub_percpu_sheaves *pcs;
+	struct slab_sheaf *sheaf;
+	unsigned long flags;
+
+	if (unlikely(kmem_cache_debug(s) || PageSlabPfmemalloc(page) ||
+		     page_to_nid(page) != numa_mem_id()))
+		return false;
+
+	local_irq_save(flags);
+	pcs = this_cpu_ptr(s->cpu_sheaves);
+	sheaf = pcs->main;
+
+	if (unlikely(sheaf->size == s->sheaf_capacity)) {
+		sheaf_flush(s, pcs->spare);
+		pcs->main = pcs->spare;
+		pcs->spare = sheaf;
+		sheaf = pcs->main;
+	}
+
+	sheaf->objects[sheaf->size++] = object;
+	local_irq_restore(flags);
+
+	stat(s, SHEAF_FREE);
+	return true;
+}
+
+static void rcu_free_sheaf(struct rcu_head *head)
+{
+	struct slab_sheaf *sheaf = container_of(head, struct slab_sheaf,
+						rcu_head);
+	struct kmem_cache *s = sheaf->cache;
+	struct slub_percpu_sheaves *pcs;
+	unsigned long flags;
+	unsigned int i, j;
+
+	/* The free hooks were skipped by kfree_rcu_sheaf() */
+	for (i = 0, j = 0; i < sheaf->size; i++) {
+		void *object = sheaf->objects[i];
+
+		slab_wipe_on_free(s, object);
+		if (!slab_free_hook(s, object))
+			sheaf->objects[j++] = object;
+	}
+	sheaf->size = j;
+
+	local_irq_save(flags);
+	pcs = this_cpu_ptr(s->cpu_sheaves);
+
+	/* Reuse the objects directly if there is room for a full sheaf */
+	if (!pcs->spare->size)
+		swap(pcs->spare, sheaf);
+	else if (!pcs->main->size)
+		swap(pcs->main, sheaf);
+	else
+		sheaf_flush(s, sheaf);
+
+	if (!pcs->rcu_free) {
+		pcs->rcu_free = sheaf;
+		sheaf = NULL;
+	}
+	local_irq_restore(flags);
+
+	kfree(sheaf);
+}
+
+/*
+ * Called by kfree_rcu() for any object. Returns true if the object was
+ * queued in the rcu sheaf of its cache, one grace period is then waited
+ * for per sheaf_capacity objects.
+ */
+bool kfree_rcu_sheaf(void *obj)
+{
+	struct slub_percpu_sheaves *pcs;
+	struct slab_sheaf *rcu_sheaf;
+	struct kmem_cache *s;
+	struct page *page;
+	unsigned long flags;
+
+	page = virt_to_head_page(obj);
+	if (unlikely(!PageSlab(page)))
+		return false;
+
+	s = page->slab_cache;
+	if (!s->cpu_sheaves || kmem_cache_debug(s) ||
+	    PageSlabPfmemalloc(page) || page_to_nid(page) != numa_mem_id())
+		return false;
+
+	local_irq_save(flags);
+	pcs = this_cpu_ptr(s->cpu_sheaves);
+	rcu_sheaf = pcs->rcu_free;
+
+	if (unlikely(!rcu_sheaf)) {
+		rcu_sheaf = alloc_empty_sheaf(s, GFP_NOWAIT | __GFP_NOWARN);
+		if (!rcu_sheaf) {
+			local_irq_restore(flags);
+			return false;
+		}
+		pcs->rcu_free = rcu_sheaf;
+	}
+
+	rcu_sheaf->objects[rcu_sheaf->size++] = obj;
+	if (rcu_sheaf->size == s->sheaf_capacity)
+		pcs->rcu_free = NULL;
+	else
+		rcu_sheaf = NULL;
+	local_irq_restore(flags);
+
+	if (rcu_sheaf)
+		call_rcu(&rcu_sheaf->rcu_head, rcu_free_sheaf);
+
+	stat(s, SHEAF_RCU);
+	return true;
+}
+
+/*
+ * Flush the main and spare sheaves of a cpu that is either the current
+ * one or dead. Must be called with interrupts disabled.
+ */
+static void flush_cpu_sheaves(struct kmem_cache *s, int cpu)
+{
+	struct slub_percpu_sheaves *pcs = per_cpu_ptr(s->cpu_sheaves, cpu);
+
+	sheaf_flush(s, pcs->main);
+	sheaf_flush(s, pcs->spare);
+}
+
+/* Start the grace period for a partially filled rcu sheaf */
+static void submit_rcu_sheaf(struct kmem_cache *s, int cpu)
+{
+	struct slub_percpu_sheaves *pcs = per_cpu_ptr(s->cpu_sheaves, cpu);
+	struct slab_sheaf *rcu_sheaf = pcs->rcu_free;
+
+	if (rcu_sheaf && rcu_sheaf->size) {
+		pcs->rcu_free = NULL;
+		call_rcu(&rcu_sheaf->rcu_head, rcu_free_sheaf);
+	}
+}
+
+static void submit_rcu_sheaf_local(void *d)
+{
+	submit_rcu_sheaf(d, smp_processor_id());
+}
+
+void kmem_cache_flush_rcu_sheaves(struct kmem_cache *s)
+{
+	if (!s->cpu_sheaves)
+		return;
+
+	on_each_cpu(submit_rcu_sheaf_local, s, 1);
+	rcu_barrier();
+}
+
+static void free_percpu_sheaves(struct kmem_cache *s)
+{
+	int cpu;
+
+	if (!s->cpu_sheaves)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct slub_percpu_sheaves *pcs;
+
+		pcs = per_cpu_ptr(s->cpu_sheaves, cpu);
+		kfree(pcs->main);
+		kfree(pcs->spare);
+		kfree(pcs->rcu_free);
+	}
+	free_percpu(s->cpu_sheaves);
+	s->cpu_sheaves = NULL;
+}
+
+static int init_percpu_sheaves(struct kmem_cache *s)
+{
+	int cpu;
+
+	/* Debugging needs every object to go through the slow paths */
+	if (!(s->flags & SLAB_SHEAVES) || slab_state < UP ||
+	    !is_root_cache(s) || kmem_cache_debug(s))
+		return 0;
+
+	/* Roughly what the cpu slab and cpu partials hold for small objects */
+	if (s->size >= PAGE_SIZE)
+		s->sheaf_capacity = 8;
+	else if (s->size >= 1024)
+		s->sheaf_capacity = 16;
+	else
+		s->sheaf_capacity = 32;
+
+	s->cpu_sheaves = alloc_percpu(struct slub_percpu_sheaves);
+	if (!s->cpu_sheaves)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct slub_percpu_sheaves *pcs;
+
+		pcs = per_cpu_ptr(s->cpu_sheaves, cpu);
+		pcs->main = alloc_empty_sheaf(s, GFP_KERNEL);
+		pcs->spare = alloc_empty_sheaf(s, GFP_KERNEL);
+		if (!pcs->main || !pcs->spare) {
+			free_percpu_sheaves(s);
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
 /* Note that interrupts must be enabled when calling this function. */
 void kmem_cache_free_bulk(struct kmem_cache *s, size_t size, void **p)
 {
@@ -3470,6 +3842,7 @@ static void free_kmem_cache_nodes(struct kmem_cache *s)
 void __kmem_cache_release(struct kmem_cache *s)
 {
 	cache_random_seq_destroy(s);
+	free_percpu_sheaves(s);
 	free_percpu(s->cpu_slab);
 	free_kmem_cache_nodes(s);
 }
@@ -3721,9 +4094,14 @@ static int kmem_cache_open(struct kmem_cache *s, slab_flags_t flags)
 	if (!init_kmem_cache_nodes(s))
 		goto error;
 
-	if (alloc_kmem_cache_cpus(s))
+	if (!alloc_kmem_cache_cpus(s))
+		goto error_nodes;
+
+	if (!init_percpu_sheaves(s))
 		return 0;
 
+	free_percpu(s->cpu_slab);
+error_nodes:
 	free_kmem_cache_nodes(s);
 error:
 	return -EINVAL;
@@ -5072,6 +5450,12 @@ static ssize_t cpu_partial_store(struct kmem_cache *s, const char *buf,
 }
 SLAB_ATTR(cpu_partial);
 
+static ssize_t sheaf_capacity_show(struct kmem_cache *s, char *buf)
+{
+	return sprintf(buf, "%u\n", s->sheaf_capacity);
+}
+SLAB_ATTR_RO(sheaf_capacity);
+
 static ssize_t ctor_show(struct kmem_cache *s, char *buf)
 {
 	if (!s->ctor)
@@ -5478,6 +5862,11 @@ STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
 STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
 STAT_ATTR(CPU_PARTIAL_NODE, cpu_partial_node);
 STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
+STAT_ATTR(SHEAF_ALLOC, sheaf_alloc);
+STAT_ATTR(SHEAF_FREE, sheaf_free);
+STAT_ATTR(SHEAF_REFILL, sheaf_refill);
+STAT_ATTR(SHEAF_FLUSH, sheaf_flush);
+STAT_ATTR(SHEAF_RCU, sheaf_rcu);
 #endif	/* CONFIG_SLUB_STATS */
 
 static struct attribute *slab_attrs[] = {
@@ -5487,6 +5876,7 @@ static struct attribute *slab_attrs[] = {
 	&order_attr.attr,
 	&min_partial_attr.attr,
 	&cpu_partial_attr.attr,
+	&sheaf_capacity_attr.attr,
 	&objects_attr.attr,
 	&objects_partial_attr.attr,
 	&partial_attr.attr,
@@ -5544,6 +5934,11 @@ static struct attribute *slab_attrs[] = {
 	&cpu_partial_free_attr.attr,
 	&cpu_partial_node_attr.attr,
 	&cpu_partial_drain_attr.attr,
+	&sheaf_alloc_attr.attr,
+	&sheaf_free_attr.attr,
+	&sheaf_refill_attr.attr,
+	&sheaf_flush_attr.attr,
+	&sheaf_rcu_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
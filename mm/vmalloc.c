@@ -35,6 +35,7 @@
 #include <linux/bitops.h>
 #include <linux/rbtree_augmented.h>
 #include <linux/overflow.h>
+#include <linux/io.h>
 
 #include <linux/uaccess.h>
 #include <asm/tlbflush.h>
@@ -50,6 +51,19 @@ static DEFINE_PER_CPU(struct vfree_deferred, vfree_deferred);
 
 static void __vunmap(const void *, int);
 
+#ifdef CONFIG_HAVE_ARCH_HUGE_VMALLOC
+static bool __ro_after_init vmap_allow_huge = true;
+
+static int __init set_nohugevmalloc(char *str)
+{
+	vmap_allow_huge = false;
+	return 0;
+}
+early_param("nohugevmalloc", set_nohugevmalloc);
+#else
+static const bool vmap_allow_huge = false;
+#endif
+
 static void free_work(struct work_struct *w)
 {
 	struct vfree_deferred *p = container_of(w, struct vfree_deferred, wq);
@@ -251,6 +265,57 @@ static int vmap_page_range(unsigned long start, unsigned long end,
 	return ret;
 }
 
+#ifdef CONFIG_HAVE_ARCH_HUGE_VMALLOC
+/*
+ * Like vmap_page_range(), but the pages come in naturally aligned and
+ * physically contiguous PMD_SIZE chunks. Each chunk is mapped with a PMD,
+ * or with ptes if the arch refuses the huge mapping.
+ */
+static int vmap_pmd_pages_range(unsigned long start, unsigned long end,
+				pgprot_t prot, struct page **pages)
+{
+	unsigned long addr = start;
+	int nr = 0;
+
+	BUG_ON(!IS_ALIGNED(start, PMD_SIZE) || !IS_ALIGNED(end, PMD_SIZE));
+	do {
+		pgd_t *pgd = pgd_offset_k(addr);
+		p4d_t *p4d;
+		pud_t *pud;
+		pmd_t *pmd;
+
+		p4d = p4d_alloc(&init_mm, pgd, addr);
+		if (!p4d)
+			return -ENOMEM;
+		pud = pud_alloc(&init_mm, p4d, addr);
+		if (!pud)
+			return -ENOMEM;
+		pmd = pmd_alloc(&init_mm, pud, addr);
+		if (!pmd)
+			return -ENOMEM;
+
+		/* An earlier small mapping may have left a pte table behind */
+		if ((!pmd_present(*pmd) || pmd_free_pte_page(pmd, addr)) &&
+		    pmd_set_huge(pmd, page_to_phys(pages[nr]), prot)) {
+			nr += PMD_SIZE >> PAGE_SHIFT;
+			continue;
+		}
+
+		if (vmap_pte_range(pmd, addr, addr + PMD_SIZE, prot, pages, &nr))
+			return -ENOMEM;
+	} while (addr += PMD_SIZE, addr != end);
+
+	flush_cache_vmap(start, end);
+	return nr;
+}
+#else
+static inline int vmap_pmd_pages_range(unsigned long start, unsigned long end,
+				       pgprot_t prot, struct page **pages)
+{
+	return -EINVAL;
+}
+#endif
+
 int is_vmalloc_or_module_addr(const void *x)
 {
 	/*
@@ -298,12 +363,21 @@ struct page *vmalloc_to_page(const void *vmalloc_addr)
 	 * that define CONFIG_HAVE_ARCH_HUGE_VMAP=y. Such regions will be
 	 * identified as vmalloc addresses by is_vmalloc_addr(), but are
 	 * not [unambiguously] associated with a struct page, so there is
-	 * no correct value to return for them.
+	 * no correct value to return for them. The exception are PMD
+	 * mappings of vmalloc_huge() memory, which are backed by pages.
 	 */
 	WARN_ON_ONCE(pud_bad(*pud));
 	if (pud_none(*pud) || pud_bad(*pud))
 		return NULL;
 	pmd = pmd_offset(pud, addr);
+#ifdef CONFIG_HAVE_ARCH_HUGE_VMALLOC
+	if (pmd_large(*pmd)) {
+		unsigned long pfn = pmd_pfn(*pmd) +
+				    ((addr & ~PMD_MASK) >> PAGE_SHIFT);
+
+		return pfn_valid(pfn) ? pfn_to_page(pfn) : NULL;
+	}
+#endif
 	WARN_ON_ONCE(pmd_bad(*pmd));
 	if (pmd_none(*pmd) || pmd_bad(*pmd))
 		return NULL;
@@ -336,7 +410,16 @@ EXPORT_SYMBOL(vmalloc_to_pfn);
 static DEFINE_SPINLOCK(vmap_area_lock);
 /* Export for kexec only */
 LIST_HEAD(vmap_area_list);
-static LLIST_HEAD(vmap_purge_list);
+
+/*
+ * Lazily freed areas are queued on the node of the freeing cpu, so that
+ * vfree() does not bounce a single list head between sockets.
+ */
+struct vmap_purge_node {
+	struct llist_head list;
+} ____cacheline_aligned_in_smp;
+
+static struct vmap_purge_node vmap_purge_nodes[MAX_NUMNODES];
 static struct rb_root vmap_area_root = RB_ROOT;
 static bool vmap_initialized __read_mostly;
 
@@ -1248,13 +1331,36 @@ void set_iounmap_nonlazy(void)
 static bool __purge_vmap_area_lazy(unsigned long start, unsigned long end)
 {
 	unsigned long resched_threshold;
-	struct llist_node *valist;
+	unsigned long nr_areas = 0, nr_pages = 0;
+	struct llist_node *valist = NULL;
 	struct vmap_area *va;
 	struct vmap_area *n_va;
+	int nid;
 
 	lockdep_assert_held(&vmap_purge_lock);
 
-	valist = llist_del_all(&vmap_purge_list);
+	/*
+	 * Gather the per node lists into one, computing the flush range on
+	 * the way. They can be up to lazy_max_pages() elements in total.
+	 */
+	for_each_node(nid) {
+		struct llist_node *list, *last = NULL;
+
+		list = llist_del_all(&vmap_purge_nodes[nid].list);
+		llist_for_each_entry(va, list, purge_list) {
+			if (va->va_start < start)
+				start = va->va_start;
+			if (va->va_end > end)
+				end = va->va_end;
+			last = &va->purge_list;
+		}
+
+		if (last) {
+			last->next = valist;
+			valist = list;
+		}
+	}
+
 	if (unlikely(valist == NULL))
 		return false;
 
@@ -1264,17 +1370,6 @@ static bool __purge_vmap_area_lazy(unsigned long start, unsigned long end)
 	 */
 	vmalloc_sync_unmappings();
 
-	/*
-	 * TODO: to calculate a flush range without looping.
-	 * The list can be up to lazy_max_pages() elements.
-	 */
-	llist_for_each_entry(va, valist, purge_list) {
-		if (va->va_start < start)
-			start = va->va_start;
-		if (va->va_end > end)
-			end = va->va_end;
-	}
-
 	flush_tlb_kernel_range(start, end);
 	resched_threshold = lazy_max_pages() << 1;
 
@@ -1282,6 +1377,9 @@ static bool __purge_vmap_area_lazy(unsigned long start, unsigned long end)
 	llist_for_each_entry_safe(va, n_va, valist, purge_list) {
 		unsigned long nr = (va->va_end - va->va_start) >> PAGE_SHIFT;
 
+		nr_areas++;
+		nr_pages += nr;
+
 		/*
 		 * Finally insert or merge lazily-freed area. It is
 		 * detached and there is no need to "unlink" it from
@@ -1296,12 +1394,34 @@ static bool __purge_vmap_area_lazy(unsigned long start, unsigned long end)
 			cond_resched_lock(&vmap_area_lock);
 	}
 	spin_unlock(&vmap_area_lock);
+
+	count_vm_event(VMAP_PURGE);
+	count_vm_events(VMAP_PURGE_AREAS, nr_areas);
+	count_vm_events(VMAP_PURGE_PAGES, nr_pages);
 	return true;
 }
 
 /*
- * Kick off a purge of the outstanding lazy areas. Don't bother if somebody
- * is already purging.
+ * Purge the outstanding lazy areas from a worker rather than from whoever
+ * happened to cross the threshold in vfree(). Keep going while frees
+ * outpace the purging.
+ */
+static void drain_vmap_area_work(struct work_struct *work)
+{
+	bool purged;
+
+	do {
+		mutex_lock(&vmap_purge_lock);
+		purged = __purge_vmap_area_lazy(ULONG_MAX, 0);
+		mutex_unlock(&vmap_purge_lock);
+	} while (purged && atomic_long_read(&vmap_lazy_nr) > lazy_max_pages());
+}
+
+static DECLARE_WORK(drain_vmap_work, drain_vmap_area_work);
+
+/*
+ * Purges all lazily-freed vmap areas, unless someone else is already
+ * purging.
  */
 static void try_purge_vmap_area_lazy(void)
 {
@@ -1339,10 +1459,17 @@ static void free_vmap_area_noflush(struct vmap_area *va)
 				PAGE_SHIFT, &vmap_lazy_nr);
 
 	/* After this point, we may free va at any time */
-	llist_add(&va->purge_list, &vmap_purge_list);
+	llist_add(&va->purge_list, &vmap_purge_nodes[numa_node_id()].list);
 
-	if (unlikely(nr_lazy > lazy_max_pages()))
+	/*
+	 * Normally the worker catches up with the freeing. If it falls
+	 * well behind, make the freeing side help out so the amount of
+	 * unpurged address space stays bounded.
+	 */
+	if (unlikely(nr_lazy > 2 * lazy_max_pages()))
 		try_purge_vmap_area_lazy();
+	else if (unlikely(nr_lazy > lazy_max_pages()))
+		schedule_work(&drain_vmap_work);
 }
 
 /*
@@ -1940,6 +2067,11 @@ void __init vmalloc_init(void)
 	 */
 	vmap_init_free_space();
 	vmap_initialized = true;
+
+#ifdef CONFIG_HAVE_ARCH_HUGE_VMALLOC
+	if (!arch_ioremap_pmd_supported())
+		vmap_allow_huge = false;
+#endif
 }
 
 /**
@@ -2398,15 +2530,22 @@ static void *__vmalloc_node(unsigned long size, unsigned long align,
 			    gfp_t gfp_mask, pgprot_t prot,
 			    int node, const void *caller);
 static void *__vmalloc_area_node(struct vm_struct *area, gfp_t gfp_mask,
-				 pgprot_t prot, int node)
+				 pgprot_t prot, unsigned int page_shift,
+				 int node)
 {
 	struct page **pages;
 	unsigned int nr_pages, array_size, i;
+	const unsigned int page_order = page_shift - PAGE_SHIFT;
 	const gfp_t nested_gfp = (gfp_mask & GFP_RECLAIM_MASK) | __GFP_ZERO;
-	const gfp_t alloc_mask = gfp_mask | __GFP_NOWARN;
+	gfp_t alloc_mask = gfp_mask | __GFP_NOWARN;
 	const gfp_t highmem_mask = (gfp_mask & (GFP_DMA | GFP_DMA32)) ?
 					0 :
 					__GFP_HIGHMEM;
+	int err;
+
+	/* Huge pages are best effort, the caller falls back to base pages */
+	if (page_order)
+		alloc_mask |= __GFP_NORETRY;
 
 	nr_pages = get_vm_area_size(area) >> PAGE_SHIFT;
 	array_size = (nr_pages * sizeof(struct page *));
@@ -2427,14 +2566,17 @@ static void *__vmalloc_area_node(struct vm_struct *area, gfp_t gfp_mask,
 
 	area->pages = pages;
 	area->nr_pages = nr_pages;
+	area->page_order = page_order;
 
-	for (i = 0; i < area->nr_pages; i++) {
+	for (i = 0; i < area->nr_pages; i += 1U << page_order) {
 		struct page *page;
+		unsigned int j;
 
 		if (node == NUMA_NO_NODE)
-			page = alloc_page(alloc_mask|highmem_mask);
+			page = alloc_pages(alloc_mask|highmem_mask, page_order);
 		else
-			page = alloc_pages_node(node, alloc_mask|highmem_mask, 0);
+			page = alloc_pages_node(node, alloc_mask|highmem_mask,
+						page_order);
 
 		if (unlikely(!page)) {
 			/* Successfully allocated i pages, free them in __vunmap() */
@@ -2442,20 +2584,37 @@ static void *__vmalloc_area_node(struct vm_struct *area, gfp_t gfp_mask,
 			atomic_long_add(area->nr_pages, &nr_vmalloc_pages);
 			goto fail;
 		}
-		area->pages[i] = page;
+
+		/* __vunmap() and vmalloc_to_page() users expect base pages */
+		if (page_order)
+			split_page(page, page_order);
+
+		for (j = 0; j < (1U << page_order); j++)
+			area->pages[i + j] = page + j;
+
 		if (gfpflags_allow_blocking(gfp_mask|highmem_mask))
 			cond_resched();
 	}
 	atomic_long_add(area->nr_pages, &nr_vmalloc_pages);
 
-	if (map_vm_area(area, prot, pages))
+	if (page_order) {
+		unsigned long addr = (unsigned long)area->addr;
+
+		err = vmap_pmd_pages_range(addr, addr + get_vm_area_size(area),
+					   prot, pages);
+		err = err > 0 ? 0 : err;
+	} else {
+		err = map_vm_area(area, prot, pages);
+	}
+	if (err)
 		goto fail;
 	return area->addr;
 
 fail:
-	warn_alloc(gfp_mask, NULL,
-			  "vmalloc: allocation failure, allocated %ld of %ld bytes",
-			  (area->nr_pages*PAGE_SIZE), area->size);
+	if (!page_order)
+		warn_alloc(gfp_mask, NULL,
+			   "vmalloc: allocation failure, allocated %ld of %ld bytes",
+			   (area->nr_pages*PAGE_SIZE), area->size);
 	__vfree(area->addr);
 	return NULL;
 }
@@ -2486,7 +2645,32 @@ void *__vmalloc_node_range(unsigned long size, unsigned long align,
 	struct vm_struct *area;
 	void *addr;
 	unsigned long real_size = size;
+	unsigned long real_align = align;
+	unsigned int shift = PAGE_SHIFT;
+
+	/*
+	 * Permission changes would have to split the PMDs again, so only
+	 * plain PAGE_KERNEL data is eligible. For NUMA_NO_NODE each node
+	 * should still get at least one huge page out of the interleaving.
+	 * split_page() doesn't split the memcg charge of a high order page,
+	 * so accounted allocations stay on small pages.
+	 */
+	if (vmap_allow_huge && (vm_flags & VM_ALLOW_HUGE_VMAP) &&
+	    !(vm_flags & VM_FLUSH_RESET_PERMS) &&
+	    !(gfp_mask & __GFP_ACCOUNT) &&
+	    pgprot_val(prot) == pgprot_val(PAGE_KERNEL)) {
+		unsigned long size_per_node = size;
+
+		if (node == NUMA_NO_NODE)
+			size_per_node /= num_online_nodes();
+		if (size_per_node >= PMD_SIZE) {
+			shift = PMD_SHIFT;
+			align = max(real_align, PMD_SIZE);
+			size = ALIGN(real_size, PMD_SIZE);
+		}
+	}
 
+again:
 	size = PAGE_ALIGN(size);
 	if (!size || (size >> PAGE_SHIFT) > totalram_pages())
 		goto fail;
@@ -2496,9 +2680,15 @@ void *__vmalloc_node_range(unsigned long size, unsigned long align,
 	if (!area)
 		goto fail;
 
-	addr = __vmalloc_area_node(area, gfp_mask, prot, node);
-	if (!addr)
+	addr = __vmalloc_area_node(area, gfp_mask, prot, shift, node);
+	if (!addr) {
+		if (shift > PAGE_SHIFT)
+			goto fail;
 		return NULL;
+	}
+
+	if (shift > PAGE_SHIFT)
+		count_vm_event(VMALLOC_HUGE);
 
 	/*
 	 * In this function, newly allocated vm_struct has VM_UNINITIALIZED
@@ -2512,6 +2702,14 @@ void *__vmalloc_node_range(unsigned long size, unsigned long align,
 	return addr;
 
 fail:
+	if (shift > PAGE_SHIFT) {
+		count_vm_event(VMALLOC_HUGE_FALLBACK);
+		shift = PAGE_SHIFT;
+		align = real_align;
+		size = real_size;
+		goto again;
+	}
+
 	warn_alloc(gfp_mask, NULL,
 			  "vmalloc: allocation failure: %lu bytes", real_size);
 	return NULL;
@@ -2595,6 +2793,54 @@ void *vmalloc(unsigned long size)
 }
 EXPORT_SYMBOL(vmalloc);
 
+/**
+ * vmalloc_huge - allocate virtually contiguous memory, allow huge pages
+ * @size:      allocation size
+ * @gfp_mask:  flags for the page level allocator
+ *
+ * Like __vmalloc() with PAGE_KERNEL, but allocations of at least
+ * PMD_SIZE per online node may be backed by PMD sized pages and mapped
+ * with PMDs, where the architecture supports it. The size is then rounded
+ * up to PMD_SIZE. Meant for large, long lived tables that are hot in the
+ * TLB.
+ *
+ * Return: pointer to the allocated memory or %NULL on error
+ */
+void *vmalloc_huge(unsigned long size, gfp_t gfp_mask)
+{
+	return __vmalloc_node_range(size, 1, VMALLOC_START, VMALLOC_END,
+				    gfp_mask, PAGE_KERNEL, VM_ALLOW_HUGE_VMAP,
+				    NUMA_NO_NODE, __builtin_return_address(0));
+}
+EXPORT_SYMBOL_GPL(vmalloc_huge);
+
+/**
+ * vmalloc_huge_node - allocate memory on a specific node, allow huge pages
+ * @size:      allocation size
+ * @gfp_mask:  flags for the page level allocator
+ * @node:      numa node
+ *
+ * Like vmalloc_huge(), but the pages come from @node, which may also be
+ * NUMA_NO_NODE.
+ *
+ * Return: pointer to the allocated memory or %NULL on error
+ */
+void *vmalloc_huge_node(unsigned long size, gfp_t gfp_mask, int node)
+{
+	return __vmalloc_node_range(size, 1, VMALLOC_START, VMALLOC_END,
+				    gfp_mask, PAGE_KERNEL, VM_ALLOW_HUGE_VMAP,
+				    node, __builtin_return_address(0));
+}
+EXPORT_SYMBOL_GPL(vmalloc_huge_node);
+
+void *vmalloc_huge_node_caller(unsigned long size, gfp_t gfp_mask, int node,
+			       const void *caller)
+{
+	return __vmalloc_node_range(size, 1, VMALLOC_START, VMALLOC_END,
+				    gfp_mask, PAGE_KERNEL, VM_ALLOW_HUGE_VMAP,
+				    node, caller);
+}
+
 /**
  * vzalloc - allocate virtually contiguous memory with zero fill
  * @size:    allocation size
@@ -3477,15 +3723,16 @@ static void show_purge_info(struct seq_file *m)
 {
 	struct llist_node *head;
 	struct vmap_area *va;
+	int nid;
 
-	head = READ_ONCE(vmap_purge_list.first);
-	if (head == NULL)
-		return;
+	for_each_node(nid) {
+		head = READ_ONCE(vmap_purge_nodes[nid].list.first);
 
-	llist_for_each_entry(va, head, purge_list) {
-		seq_printf(m, "0x%pK-0x%pK %7ld unpurged vm_area\n",
-			(void *)va->va_start, (void *)va->va_end,
-			va->va_end - va->va_start);
+		llist_for_each_entry(va, head, purge_list) {
+			seq_printf(m, "0x%pK-0x%pK %7ld unpurged vm_area\n",
+				(void *)va->va_start, (void *)va->va_end,
+				va->va_end - va->va_start);
+		}
 	}
 }
 
@@ -3537,6 +3784,9 @@ static int s_show(struct seq_file *m, void *p)
 	if (v->flags & VM_DMA_COHERENT)
 		seq_puts(m, " dma-coherent");
 
+	if (v->page_order)
+		seq_puts(m, " huge");
+
 	if (is_vmalloc_addr(v->pages))
 		seq_puts(m, " vpages");
 
@@ -638,6 +638,88 @@ int dev_fill_metadata_dst(struct net_device *dev, struct sk_buff *skb)
 }
 EXPORT_SYMBOL_GPL(dev_fill_metadata_dst);
 
+static struct net_device_path *dev_fwd_path(struct net_device_path_stack *stack)
+{
+	int k = stack->num_paths++;
+
+	if (WARN_ON_ONCE(k >= NET_DEVICE_PATH_STACK_MAX))
+		return NULL;
+
+	return &stack->path[k];
+}
+
+static int vlan_fill_forward_path(struct net_device_path_ctx *ctx,
+				  struct net_device_path *path)
+{
+	const struct net_device *dev = ctx->dev;
+
+	path->type = DEV_PATH_VLAN;
+	path->encap.id = vlan_dev_vlan_id(dev);
+	path->encap.proto = vlan_dev_vlan_proto(dev);
+	path->dev = dev;
+	ctx->dev = vlan_dev_real_dev(dev);
+
+	return 0;
+}
+
+/**
+ *	dev_fill_forward_path - resolve the devices a packet is sent through
+ *	@dev: device the packet is routed to
+ *	@daddr: link layer destination address of the packet
+ *	@stack: filled with one entry per device, the last one being the
+ *		real device the packet leaves on
+ *
+ *	Walks down stacked devices (VLAN, bridge, PPPoE, ...) for users that
+ *	want to bypass them, e.g. the netfilter flowtable. Must be called
+ *	under rcu_read_lock(). Returns 0 on success, -1 if some device on
+ *	the way does not allow to be bypassed.
+ */
+int dev_fill_forward_path(const struct net_device *dev, const u8 *daddr,
+			  struct net_device_path_stack *stack)
+{
+	const struct net_device *last_dev;
+	struct net_device_path_ctx ctx = {
+		.dev	= dev,
+		.daddr	= daddr,
+	};
+	struct net_device_path *path;
+	int ret;
+
+	stack->num_paths = 0;
+	while (ctx.dev && (is_vlan_dev(ctx.dev) ||
+			   ctx.dev->netdev_ops->ndo_fill_forward_path)) {
+		last_dev = ctx.dev;
+		path = dev_fwd_path(stack);
+		if (!path)
+			return -1;
+
+		memset(path, 0, sizeof(struct net_device_path));
+		if (is_vlan_dev(ctx.dev))
+			ret = vlan_fill_forward_path(&ctx, path);
+		else
+			ret = ctx.dev->netdev_ops->ndo_fill_forward_path(&ctx,
+									 path);
+		if (ret < 0)
+			return -1;
+
+		if (WARN_ON_ONCE(last_dev == ctx.dev))
+			return -1;
+	}
+
+	if (!ctx.dev)
+		return -1;
+
+	path = dev_fwd_path(stack);
+	if (!path)
+		return -1;
+
+	path->type = DEV_PATH_ETHERNET;
+	path->dev = ctx.dev;
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(dev_fill_forward_path);
+
 /**
  *	__dev_get_by_name	- find a device by its name
  *	@net: the applicable net namespace
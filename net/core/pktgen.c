@@ -239,6 +239,9 @@ static char *pkt_flag_names[] = {
 
 #define MAX_CFLOWS  65536
 
+#define MAX_IMIX_ENTRIES 20
+#define IMIX_PRECISION 100 /* Precision of IMIX distribution */
+
 #define VLAN_TAG_SIZE(x) ((x)->vlan_id == 0xffff ? 0 : 4)
 #define SVLAN_TAG_SIZE(x) ((x)->svlan_id == 0xffff ? 0 : 4)
 
@@ -254,6 +257,12 @@ struct flow_state {
 /* flow flag bits */
 #define F_INIT   (1<<0)		/* flow has been initialized */
 
+struct imix_pkt {
+	u64 size;
+	u64 weight;
+	u64 count_so_far;
+};
+
 struct pktgen_dev {
 	/*
 	 * Try to keep frequent/infrequent used vars. separated.
@@ -373,6 +382,12 @@ struct pktgen_dev {
 	__u32 cur_pkt_size;
 	__u32 last_pkt_size;
 
+	/* IMIX */
+	unsigned int n_imix_entries;
+	struct imix_pkt imix_entries[MAX_IMIX_ENTRIES];
+	/* Maps 0-IMIX_PRECISION range to imix_entry based on probability */
+	__u8 imix_distribution[IMIX_PRECISION];
+
 	__u8 hh[14];
 	/* = {
 	   0x00, 0x80, 0xC8, 0x79, 0xB3, 0xCB,
@@ -563,6 +578,16 @@ static int pktgen_if_show(struct seq_file *seq, void *v)
 	seq_printf(seq, "     flows: %u flowlen: %u\n", pkt_dev->cflows,
 		   pkt_dev->lflow);
 
+	if (pkt_dev->n_imix_entries > 0) {
+		seq_puts(seq, "     imix_weights: ");
+		for (i = 0; i < pkt_dev->n_imix_entries; i++) {
+			seq_printf(seq, "%llu,%llu ",
+				   pkt_dev->imix_entries[i].size,
+				   pkt_dev->imix_entries[i].weight);
+		}
+		seq_puts(seq, "\n");
+	}
+
 	seq_printf(seq,
 		   "     queue_map_min: %u  queue_map_max: %u\n",
 		   pkt_dev->queue_map_min,
@@ -698,6 +723,16 @@ static int pktgen_if_show(struct seq_file *seq, void *v)
 
 	seq_printf(seq, "     flows: %u\n", pkt_dev->nflows);
 
+	if (pkt_dev->n_imix_entries > 0) {
+		seq_puts(seq, "     imix_size_counts: ");
+		for (i = 0; i < pkt_dev->n_imix_entries; i++) {
+			seq_printf(seq, "%llu,%llu ",
+				   pkt_dev->imix_entries[i].size,
+				   pkt_dev->imix_entries[i].count_so_far);
+		}
+		seq_puts(seq, "\n");
+	}
+
 	if (pkt_dev->result[0])
 		seq_printf(seq, "Result: %s\n", pkt_dev->result);
 	else
@@ -795,6 +830,96 @@ static int strn_len(const char __user * user_buffer, unsigned int maxlen)
 	return i;
 }
 
+/* Parses imix entries from user buffer.
+ * The user buffer should consist of imix entries separated by spaces
+ * where each entry consists of size and weight delimited by commas.
+ * "size1,weight_1 size2,weight_2 ... size_n,weight_n" for example.
+ */
+static ssize_t get_imix_entries(const char __user *buffer,
+				struct pktgen_dev *pkt_dev)
+{
+	const int max_digits = 10;
+	unsigned int n = 0;
+	ssize_t i = 0;
+	long len;
+	char c;
+
+	pkt_dev->n_imix_entries = 0;
+
+	do {
+		unsigned long weight;
+		unsigned long size;
+
+		if (n >= MAX_IMIX_ENTRIES)
+			return -E2BIG;
+
+		len = num_arg(&buffer[i], max_digits, &size);
+		if (len < 0)
+			return len;
+		i += len;
+		if (get_user(c, &buffer[i]))
+			return -EFAULT;
+		/* Check for comma between size_i and weight_i */
+		if (c != ',')
+			return -EINVAL;
+		i++;
+
+		if (size < 14 + 20 + 8)
+			size = 14 + 20 + 8;
+
+		len = num_arg(&buffer[i], max_digits, &weight);
+		if (len < 0)
+			return len;
+		if (weight <= 0)
+			return -EINVAL;
+
+		pkt_dev->imix_entries[n].size = size;
+		pkt_dev->imix_entries[n].weight = weight;
+		pkt_dev->imix_entries[n].count_so_far = 0;
+
+		i += len;
+		if (get_user(c, &buffer[i]))
+			return -EFAULT;
+
+		i++;
+		n++;
+	} while (c == ' ');
+
+	pkt_dev->n_imix_entries = n;
+	return i;
+}
+
+/* Spread the entries over IMIX_PRECISION slots in proportion to their
+ * weights, so that picking a packet size costs a single random number.
+ */
+static void fill_imix_distribution(struct pktgen_dev *pkt_dev)
+{
+	int cumulative_probabilities[MAX_IMIX_ENTRIES];
+	__u64 cumulative_prob = 0;
+	__u64 total_weight = 0;
+	int i, j = 0;
+
+	if (!pkt_dev->n_imix_entries)
+		return;
+
+	for (i = 0; i < pkt_dev->n_imix_entries; i++)
+		total_weight += pkt_dev->imix_entries[i].weight;
+
+	/* Fill cumulative_probabilities with sum of normalized probabilities */
+	for (i = 0; i < pkt_dev->n_imix_entries - 1; i++) {
+		cumulative_prob += div64_u64(pkt_dev->imix_entries[i].weight *
+					     IMIX_PRECISION, total_weight);
+		cumulative_probabilities[i] = cumulative_prob;
+	}
+	cumulative_probabilities[pkt_dev->n_imix_entries - 1] = IMIX_PRECISION;
+
+	for (i = 0; i < IMIX_PRECISION; i++) {
+		while (i >= cumulative_probabilities[j])
+			j++;
+		pkt_dev->imix_distribution[i] = j;
+	}
+}
+
 static ssize_t get_labels(const char __user *buffer, struct pktgen_dev *pkt_dev)
 {
 	unsigned int n = 0;
@@ -1089,12 +1214,30 @@ static ssize_t pktgen_if_write(struct file *file,
 		    ((pkt_dev->xmit_mode == M_NETIF_RECEIVE) ||
 		     !(pkt_dev->odev->priv_flags & IFF_TX_SKB_SHARING)))
 			return -ENOTSUPP;
+		/* every IMIX packet needs its own size */
+		if (value > 0 && pkt_dev->n_imix_entries > 0)
+			return -EINVAL;
 		i += len;
 		pkt_dev->clone_skb = value;
 
 		sprintf(pg_result, "OK: clone_skb=%d", pkt_dev->clone_skb);
 		return count;
 	}
+	if (!strcmp(name, "imix_weights")) {
+		if (pkt_dev->clone_skb > 0)
+			return -EINVAL;
+
+		len = get_imix_entries(&user_buffer[i], pkt_dev);
+		if (len < 0)
+			return len;
+
+		fill_imix_distribution(pkt_dev);
+
+		i += len;
+		sprintf(pg_result, "OK: imix_weights=%u entries",
+			pkt_dev->n_imix_entries);
+		return count;
+	}
 	if (!strcmp(name, "count")) {
 		len = num_arg(&user_buffer[i], 10, &value);
 		if (len < 0)
@@ -2468,7 +2611,18 @@ static void mod_cur_headers(struct pktgen_dev *pkt_dev)
 		}
 	}
 
-	if (pkt_dev->min_pkt_size < pkt_dev->max_pkt_size) {
+	if (pkt_dev->n_imix_entries > 0) {
+		struct imix_pkt *curr_pkt;
+		__u32 t;
+		__u8 entry_index;
+
+		t = prandom_u32() % IMIX_PRECISION;
+		entry_index = pkt_dev->imix_distribution[t];
+
+		curr_pkt = &pkt_dev->imix_entries[entry_index];
+		curr_pkt->count_so_far++;
+		pkt_dev->cur_pkt_size = curr_pkt->size;
+	} else if (pkt_dev->min_pkt_size < pkt_dev->max_pkt_size) {
 		__u32 t;
 		if (pkt_dev->flags & F_TXSIZE_RND) {
 			t = prandom_u32() %
@@ -2985,11 +3139,15 @@ static struct sk_buff *fill_packet(struct net_device *odev,
 
 static void pktgen_clear_counters(struct pktgen_dev *pkt_dev)
 {
+	unsigned int i;
+
 	pkt_dev->seq_num = 1;
 	pkt_dev->idle_acc = 0;
 	pkt_dev->sofar = 0;
 	pkt_dev->tx_bytes = 0;
 	pkt_dev->errors = 0;
+	for (i = 0; i < pkt_dev->n_imix_entries; i++)
+		pkt_dev->imix_entries[i].count_so_far = 0;
 }
 
 /* Set up structure for sending pkts, clear counters */
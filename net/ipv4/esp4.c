@@ -33,6 +33,11 @@ struct esp_output_extra {
 
 #define ESP_SKB_CB(__skb) ((struct esp_skb_cb *)&((__skb)->cb[0]))
 
+/* Covers the temporary buffer of AES-GCM and AES-CBC/HMAC with a few frags */
+#define ESP_TMP_CACHE_SIZE	1024
+
+static struct crypto_req_cache esp_tmp_cache;
+
 /*
  * Allocate an AEAD request structure with extra space for SG and IV.
  *
@@ -60,7 +65,7 @@ static void *esp_alloc_tmp(struct crypto_aead *aead, int nfrags, int extralen)
 
 	len += sizeof(struct scatterlist) * nfrags;
 
-	return kmalloc(len, GFP_ATOMIC);
+	return crypto_req_cache_alloc(&esp_tmp_cache, len, GFP_ATOMIC);
 }
 
 static inline void *esp_tmp_extra(void *tmp)
@@ -134,7 +139,7 @@ static void esp_output_done(struct crypto_async_request *base, int err)
 
 	tmp = ESP_SKB_CB(skb)->tmp;
 	esp_ssg_unref(x, tmp);
-	kfree(tmp);
+	crypto_req_cache_free(&esp_tmp_cache, tmp);
 
 	if (xo && (xo->flags & XFRM_DEV_RESUME)) {
 		if (err) {
@@ -475,7 +480,7 @@ int esp_output_tail(struct xfrm_state *x, struct sk_buff *skb, struct esp_info *
 		esp_ssg_unref(x, tmp);
 
 error_free:
-	kfree(tmp);
+	crypto_req_cache_free(&esp_tmp_cache, tmp);
 error:
 	return err;
 }
@@ -586,7 +591,7 @@ int esp_input_done2(struct sk_buff *skb, int err)
 	int ihl;
 
 	if (!xo || (xo && !(xo->flags & CRYPTO_DONE)))
-		kfree(ESP_SKB_CB(skb)->tmp);
+		crypto_req_cache_free(&esp_tmp_cache, ESP_SKB_CB(skb)->tmp);
 
 	if (unlikely(err))
 		goto out;
@@ -759,7 +764,7 @@ static int esp_input(struct xfrm_state *x, struct sk_buff *skb)
 	sg_init_table(sg, nfrags);
 	err = skb_to_sgvec(skb, sg, 0, skb->len);
 	if (unlikely(err < 0)) {
-		kfree(tmp);
+		crypto_req_cache_free(&esp_tmp_cache, tmp);
 		goto out;
 	}
 
@@ -1025,13 +1030,17 @@ static struct xfrm4_protocol esp4_protocol = {
 
 static int __init esp4_init(void)
 {
+	if (crypto_req_cache_init(&esp_tmp_cache, ESP_TMP_CACHE_SIZE))
+		return -ENOMEM;
 	if (xfrm_register_type(&esp_type, AF_INET) < 0) {
 		pr_info("%s: can't add xfrm type\n", __func__);
+		crypto_req_cache_destroy(&esp_tmp_cache);
 		return -EAGAIN;
 	}
 	if (xfrm4_protocol_register(&esp4_protocol, IPPROTO_ESP) < 0) {
 		pr_info("%s: can't add protocol\n", __func__);
 		xfrm_unregister_type(&esp_type, AF_INET);
+		crypto_req_cache_destroy(&esp_tmp_cache);
 		return -EAGAIN;
 	}
 	return 0;
@@ -1042,6 +1051,7 @@ static void __exit esp4_fini(void)
 	if (xfrm4_protocol_deregister(&esp4_protocol, IPPROTO_ESP) < 0)
 		pr_info("%s: can't remove protocol\n", __func__);
 	xfrm_unregister_type(&esp_type, AF_INET);
+	crypto_req_cache_destroy(&esp_tmp_cache);
 }
 
 module_init(esp4_init);
@@ -22,6 +22,8 @@ static void remove_nexthop(struct net *net, struct nexthop *nh,
 #define NH_DEV_HASHBITS  8
 #define NH_DEV_HASHSIZE (1U << NH_DEV_HASHBITS)
 
+#define NH_RES_DEFAULT_NUM_BUCKETS	128
+
 static const struct nla_policy rtm_nh_policy[NHA_MAX + 1] = {
 	[NHA_UNSPEC]		= { .strict_start_type = NHA_UNSPEC + 1 },
 	[NHA_ID]		= { .type = NLA_U32 },
@@ -34,6 +36,12 @@ static const struct nla_policy rtm_nh_policy[NHA_MAX + 1] = {
 	[NHA_ENCAP]		= { .type = NLA_NESTED },
 	[NHA_GROUPS]		= { .type = NLA_FLAG },
 	[NHA_MASTER]		= { .type = NLA_U32 },
+	[NHA_FDB]		= { .type = NLA_FLAG },
+	[NHA_RES_GROUP]		= { .type = NLA_NESTED },
+};
+
+static const struct nla_policy rtm_nh_res_policy[NHA_RES_GROUP_MAX + 1] = {
+	[NHA_RES_GROUP_BUCKETS]	= { .type = NLA_U16 },
 };
 
 static unsigned int nh_dev_hashfn(unsigned int val)
@@ -73,7 +81,9 @@ static void nexthop_free_mpath(struct nexthop *nh)
 
 	WARN_ON(nhg->spare == nhg);
 
+	kvfree(nhg->spare->res_table);
 	kfree(nhg->spare);
+	kvfree(nhg->res_table);
 	kfree(nhg);
 }
 
@@ -133,6 +143,18 @@ static struct nh_group *nexthop_grp_alloc(u16 num_nh)
 	return nhg;
 }
 
+static struct nh_res_table *nh_res_table_alloc(u16 num_nh_buckets)
+{
+	struct nh_res_table *res_table;
+
+	res_table = kvzalloc(struct_size(res_table, nh_buckets,
+					 num_nh_buckets), GFP_KERNEL);
+	if (res_table)
+		res_table->num_nh_buckets = num_nh_buckets;
+
+	return res_table;
+}
+
 static void nh_base_seq_inc(struct net *net)
 {
 	while (++net->nexthop.seq == 0)
@@ -189,7 +211,9 @@ static int nla_put_nh_group(struct sk_buff *skb, struct nh_group *nhg)
 	u16 group_type = 0;
 	int i;
 
-	if (nhg->mpath)
+	if (nhg->resilient)
+		group_type = NEXTHOP_GRP_TYPE_RES;
+	else if (nhg->mpath)
 		group_type = NEXTHOP_GRP_TYPE_MPATH;
 
 	if (nla_put_u16(skb, NHA_GROUP_TYPE, group_type))
@@ -206,6 +230,20 @@ static int nla_put_nh_group(struct sk_buff *skb, struct nh_group *nhg)
 		p += 1;
 	}
 
+	if (nhg->resilient) {
+		struct nlattr *nest;
+
+		nest = nla_nest_start(skb, NHA_RES_GROUP);
+		if (!nest)
+			goto nla_put_failure;
+
+		if (nla_put_u16(skb, NHA_RES_GROUP_BUCKETS,
+				nhg->res_table->num_nh_buckets))
+			goto nla_put_failure;
+
+		nla_nest_end(skb, nest);
+	}
+
 	return 0;
 
 nla_put_failure:
@@ -292,9 +330,14 @@ static size_t nh_nlmsg_size_grp(struct nexthop *nh)
 {
 	struct nh_group *nhg = rtnl_dereference(nh->nh_grp);
 	size_t sz = sizeof(struct nexthop_grp) * nhg->num_nh;
+	size_t tot = nla_total_size(sz) +
+		     nla_total_size(2);  /* NHA_GROUP_TYPE */
 
-	return nla_total_size(sz) +
-	       nla_total_size(2);  /* NHA_GROUP_TYPE */
+	if (nhg->resilient)
+		tot += nla_total_size(0) +  /* NHA_RES_GROUP */
+		       nla_total_size(2);   /* NHA_RES_GROUP_BUCKETS */
+
+	return tot;
 }
 
 static size_t nh_nlmsg_size_single(struct nexthop *nh)
@@ -443,7 +486,7 @@ static int nh_check_attr_group(struct net *net, struct nlattr *tb[],
 			return -EINVAL;
 	}
 	for (i = NHA_GROUP_TYPE + 1; i < __NHA_MAX; ++i) {
-		if (!tb[i])
+		if (!tb[i] || i == NHA_RES_GROUP)
 			continue;
 
 		NL_SET_ERR_MSG(extack,
@@ -487,37 +530,36 @@ static bool ipv4_good_nh(const struct fib_nh *nh)
 	return !!(state & NUD_VALID);
 }
 
-struct nexthop *nexthop_select_path(struct nexthop *nh, int hash)
+static bool nexthop_is_good_nh(const struct nexthop *nh)
+{
+	struct nh_info *nhi = rcu_dereference(nh->nh_info);
+
+	/* nexthops always check if it is good and does
+	 * not rely on a sysctl for this behavior
+	 */
+	switch (nhi->family) {
+	case AF_INET:
+		return ipv4_good_nh(&nhi->fib_nh);
+	case AF_INET6:
+		return ipv6_good_nh(&nhi->fib6_nh);
+	}
+
+	return false;
+}
+
+static struct nexthop *nexthop_select_path_mp(struct nh_group *nhg, int hash)
 {
 	struct nexthop *rc = NULL;
-	struct nh_group *nhg;
 	int i;
 
-	if (!nh->is_group)
-		return nh;
-
-	nhg = rcu_dereference(nh->nh_grp);
 	for (i = 0; i < nhg->num_nh; ++i) {
 		struct nh_grp_entry *nhge = &nhg->nh_entries[i];
-		struct nh_info *nhi;
 
 		if (hash > atomic_read(&nhge->upper_bound))
 			continue;
 
-		/* nexthops always check if it is good and does
-		 * not rely on a sysctl for this behavior
-		 */
-		nhi = rcu_dereference(nhge->nh->nh_info);
-		switch (nhi->family) {
-		case AF_INET:
-			if (ipv4_good_nh(&nhi->fib_nh))
-				return nhge->nh;
-			break;
-		case AF_INET6:
-			if (ipv6_good_nh(&nhi->fib6_nh))
-				return nhge->nh;
-			break;
-		}
+		if (nexthop_is_good_nh(nhge->nh))
+			return nhge->nh;
 
 		if (!rc)
 			rc = nhge->nh;
@@ -525,6 +567,39 @@ struct nexthop *nexthop_select_path(struct nexthop *nh, int hash)
 
 	return rc;
 }
+
+static struct nexthop *nexthop_select_path_res(struct nh_group *nhg, int hash)
+{
+	struct nh_res_table *res_table = nhg->res_table;
+	struct nexthop *nh;
+	u32 bucket_index;
+
+	/* hash is 31 bits wide, scale it to the table without a divide */
+	bucket_index = ((u64)(u32)hash * res_table->num_nh_buckets) >> 31;
+	nh = READ_ONCE(res_table->nh_buckets[bucket_index]);
+	if (likely(nh && nexthop_is_good_nh(nh)))
+		return nh;
+
+	/* the nexthop owning the bucket is unusable, fall back to
+	 * hash-threshold selection among the others without touching
+	 * the table; the flow moves back once the neighbour recovers
+	 */
+	return nexthop_select_path_mp(nhg, hash);
+}
+
+struct nexthop *nexthop_select_path(struct nexthop *nh, int hash)
+{
+	struct nh_group *nhg;
+
+	if (!nh->is_group)
+		return nh;
+
+	nhg = rcu_dereference(nh->nh_grp);
+	if (nhg->resilient)
+		return nexthop_select_path_res(nhg, hash);
+
+	return nexthop_select_path_mp(nhg, hash);
+}
 EXPORT_SYMBOL_GPL(nexthop_select_path);
 
 int nexthop_for_each_fib6_nh(struct nexthop *nh,
@@ -702,6 +777,90 @@ static void nh_group_rebalance(struct nh_group *nhg)
 	}
 }
 
+static struct nh_grp_entry *nh_res_group_find_entry(struct nh_group *nhg,
+						    const struct nexthop *nh)
+{
+	int i;
+
+	for (i = 0; i < nhg->num_nh; ++i) {
+		if (nhg->nh_entries[i].nh == nh)
+			return &nhg->nh_entries[i];
+	}
+
+	return NULL;
+}
+
+/* Distribute the buckets of @nhg proportionally to the weights. Buckets
+ * that @old assigned to a nexthop which is still a member and not over
+ * its share keep their nexthop, only the remaining ones are handed out
+ * to the members that are short. @old may be NULL for a new group.
+ */
+static void nh_res_group_rebalance(struct nh_group *nhg,
+				   const struct nh_res_table *old)
+{
+	struct nh_res_table *res_table = nhg->res_table;
+	u16 num_nh_buckets = res_table->num_nh_buckets;
+	u16 num_old = old ? min(old->num_nh_buckets, num_nh_buckets) : 0;
+	struct nh_grp_entry *nhge, *next;
+	u16 prev = 0, b;
+	int total = 0;
+	int w = 0;
+	int i;
+
+	for (i = 0; i < nhg->num_nh; ++i)
+		total += nhg->nh_entries[i].weight;
+
+	for (i = 0; i < nhg->num_nh; ++i) {
+		u16 upper;
+
+		nhge = &nhg->nh_entries[i];
+		w += nhge->weight;
+		upper = DIV_ROUND_CLOSEST_ULL((u64)w * num_nh_buckets, total);
+		nhge->res_wants = upper - prev;
+		nhge->res_count = 0;
+		prev = upper;
+	}
+
+	/* count the buckets each member keeps from @old, no bucket is
+	 * written until its final owner is known
+	 */
+	for (b = 0; b < num_old; ++b) {
+		nhge = nh_res_group_find_entry(nhg, old->nh_buckets[b]);
+		if (nhge && nhge->res_count < nhge->res_wants)
+			nhge->res_count++;
+	}
+
+	/* from here on res_count is the number of buckets a member still
+	 * keeps and res_wants the number it is still short
+	 */
+	for (i = 0; i < nhg->num_nh; ++i) {
+		nhge = &nhg->nh_entries[i];
+		nhge->res_wants -= nhge->res_count;
+	}
+
+	/* Keeping the first res_count buckets of a member picks the same
+	 * ones as the count above, and the wants left add up to the number
+	 * of buckets not kept, so every bucket gets a non-NULL nexthop in
+	 * a single store.
+	 */
+	next = nhg->nh_entries;
+	for (b = 0; b < num_nh_buckets; ++b) {
+		nhge = NULL;
+		if (b < num_old)
+			nhge = nh_res_group_find_entry(nhg, old->nh_buckets[b]);
+
+		if (nhge && nhge->res_count) {
+			nhge->res_count--;
+		} else {
+			while (!next->res_wants)
+				next++;
+			next->res_wants--;
+			nhge = next;
+		}
+		WRITE_ONCE(res_table->nh_buckets[b], nhge->nh);
+	}
+}
+
 static void remove_nh_grp_entry(struct net *net, struct nh_grp_entry *nhge,
 				struct nl_info *nlinfo)
 {
@@ -724,6 +883,7 @@ static void remove_nh_grp_entry(struct net *net, struct nh_grp_entry *nhge,
 
 	newg->has_v4 = nhg->has_v4;
 	newg->mpath = nhg->mpath;
+	newg->resilient = nhg->resilient;
 	newg->num_nh = nhg->num_nh;
 
 	/* copy old entries to new except the one getting removed */
@@ -745,6 +905,8 @@ static void remove_nh_grp_entry(struct net *net, struct nh_grp_entry *nhge,
 	}
 
 	nh_group_rebalance(newg);
+	if (newg->resilient)
+		nh_res_group_rebalance(newg, nhg->res_table);
 	rcu_assign_pointer(nhp->nh_grp, newg);
 
 	list_del(&nhge->nh_list);
@@ -865,6 +1027,10 @@ static int replace_nexthop_grp(struct net *net, struct nexthop *old,
 	oldg = rtnl_dereference(old->nh_grp);
 	newg = rtnl_dereference(new->nh_grp);
 
+	/* keep flows on their nexthops across the replace where possible */
+	if (oldg->resilient && newg->resilient)
+		nh_res_group_rebalance(newg, oldg->res_table);
+
 	/* update parents - used by nexthop code for cleanup */
 	for (i = 0; i < newg->num_nh; i++)
 		newg->nh_entries[i].nh_parent = old;
@@ -1122,13 +1288,31 @@ static struct nexthop *nexthop_create_group(struct net *net,
 
 	/* spare group used for removals */
 	nhg->spare = nexthop_grp_alloc(num_nh);
-	if (!nhg) {
+	if (!nhg->spare) {
 		kfree(nhg);
 		kfree(nh);
-		return NULL;
+		return ERR_PTR(-ENOMEM);
 	}
 	nhg->spare->spare = nhg;
 
+	if (cfg->nh_grp_type == NEXTHOP_GRP_TYPE_RES) {
+		u16 num_nh_buckets = cfg->nh_grp_res_num_buckets;
+
+		/* the spare needs its own table, removals build the new
+		 * bucket assignment from the one in use
+		 */
+		nhg->res_table = nh_res_table_alloc(num_nh_buckets);
+		nhg->spare->res_table = nh_res_table_alloc(num_nh_buckets);
+		if (!nhg->res_table || !nhg->spare->res_table) {
+			kvfree(nhg->spare->res_table);
+			kvfree(nhg->res_table);
+			kfree(nhg->spare);
+			kfree(nhg);
+			kfree(nh);
+			return ERR_PTR(-ENOMEM);
+		}
+	}
+
 	for (i = 0; i < nhg->num_nh; ++i) {
 		struct nexthop *nhe;
 		struct nh_info *nhi;
@@ -1150,6 +1334,11 @@ static struct nexthop *nexthop_create_group(struct net *net,
 	if (cfg->nh_grp_type == NEXTHOP_GRP_TYPE_MPATH) {
 		nhg->mpath = 1;
 		nh_group_rebalance(nhg);
+	} else if (cfg->nh_grp_type == NEXTHOP_GRP_TYPE_RES) {
+		nhg->mpath = 1;
+		nhg->resilient = 1;
+		nh_group_rebalance(nhg);
+		nh_res_group_rebalance(nhg, NULL);
 	}
 
 	rcu_assign_pointer(nh->nh_grp, nhg);
@@ -1160,7 +1349,9 @@ static struct nexthop *nexthop_create_group(struct net *net,
 	for (; i >= 0; --i)
 		nexthop_put(nhg->nh_entries[i].nh);
 
+	kvfree(nhg->spare->res_table);
 	kfree(nhg->spare);
+	kvfree(nhg->res_table);
 	kfree(nhg);
 	kfree(nh);
 
@@ -1326,6 +1517,33 @@ static struct nexthop *nexthop_add(struct net *net, struct nh_config *cfg,
 	return nh;
 }
 
+static int rtm_to_nh_config_grp_res(struct nlattr *res, struct nh_config *cfg,
+				    struct netlink_ext_ack *extack)
+{
+	struct nlattr *tb[NHA_RES_GROUP_MAX + 1];
+	int err;
+
+	cfg->nh_grp_res_num_buckets = NH_RES_DEFAULT_NUM_BUCKETS;
+	if (!res)
+		return 0;
+
+	err = nla_parse_nested(tb, NHA_RES_GROUP_MAX, res, rtm_nh_res_policy,
+			       extack);
+	if (err < 0)
+		return err;
+
+	if (tb[NHA_RES_GROUP_BUCKETS]) {
+		cfg->nh_grp_res_num_buckets =
+			nla_get_u16(tb[NHA_RES_GROUP_BUCKETS]);
+		if (!cfg->nh_grp_res_num_buckets) {
+			NL_SET_ERR_MSG(extack, "Number of buckets must be non-zero");
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
 static int rtm_to_nh_config(struct net *net, struct sk_buff *skb,
 			    struct nlmsghdr *nlh, struct nh_config *cfg,
 			    struct netlink_ext_ack *extack)
@@ -1367,6 +1585,12 @@ static int rtm_to_nh_config(struct net *net, struct sk_buff *skb,
 		goto out;
 	}
 
+	if (tb[NHA_FDB]) {
+		NL_SET_ERR_MSG(extack, "FDB nexthops are not supported");
+		err = -EOPNOTSUPP;
+		goto out;
+	}
+
 	memset(cfg, 0, sizeof(*cfg));
 	cfg->nlflags = nlh->nlmsg_flags;
 	cfg->nlinfo.portid = NETLINK_CB(skb).portid;
@@ -1395,6 +1619,17 @@ static int rtm_to_nh_config(struct net *net, struct sk_buff *skb,
 			NL_SET_ERR_MSG(extack, "Invalid group type");
 			goto out;
 		}
+
+		if (cfg->nh_grp_type == NEXTHOP_GRP_TYPE_RES) {
+			err = rtm_to_nh_config_grp_res(tb[NHA_RES_GROUP], cfg,
+						       extack);
+			if (err)
+				goto out;
+		} else if (tb[NHA_RES_GROUP]) {
+			NL_SET_ERR_MSG(extack, "Resilient group attributes require a resilient group type");
+			err = -EINVAL;
+			goto out;
+		}
 		err = nh_check_attr_group(net, tb, extack);
 
 		/* no other attributes should be set */
@@ -1413,6 +1648,11 @@ static int rtm_to_nh_config(struct net *net, struct sk_buff *skb,
 		goto out;
 	}
 
+	if (tb[NHA_RES_GROUP]) {
+		NL_SET_ERR_MSG(extack, "Resilient group attributes require a nexthop group");
+		goto out;
+	}
+
 	if (!tb[NHA_OIF]) {
 		NL_SET_ERR_MSG(extack, "Device attribute required for non-blackhole nexthops");
 		goto out;
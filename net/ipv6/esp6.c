@@ -41,6 +41,11 @@ struct esp_skb_cb {
 
 #define ESP_SKB_CB(__skb) ((struct esp_skb_cb *)&((__skb)->cb[0]))
 
+/* Covers the temporary buffer of AES-GCM and AES-CBC/HMAC with a few frags */
+#define ESP_TMP_CACHE_SIZE	1024
+
+static struct crypto_req_cache esp_tmp_cache;
+
 /*
  * Allocate an AEAD request structure with extra space for SG and IV.
  *
@@ -69,7 +74,7 @@ static void *esp_alloc_tmp(struct crypto_aead *aead, int nfrags, int seqihlen)
 
 	len += sizeof(struct scatterlist) * nfrags;
 
-	return kmalloc(len, GFP_ATOMIC);
+	return crypto_req_cache_alloc(&esp_tmp_cache, len, GFP_ATOMIC);
 }
 
 static inline __be32 *esp_tmp_seqhi(void *tmp)
@@ -141,7 +146,7 @@ static void esp_output_done(struct crypto_async_request *base, int err)
 
 	tmp = ESP_SKB_CB(skb)->tmp;
 	esp_ssg_unref(x, tmp);
-	kfree(tmp);
+	crypto_req_cache_free(&esp_tmp_cache, tmp);
 
 	if (xo && (xo->flags & XFRM_DEV_RESUME)) {
 		if (err) {
@@ -416,7 +421,7 @@ int esp6_output_tail(struct xfrm_state *x, struct sk_buff *skb, struct esp_info
 		esp_ssg_unref(x, tmp);
 
 error_free:
-	kfree(tmp);
+	crypto_req_cache_free(&esp_tmp_cache, tmp);
 error:
 	return err;
 }
@@ -524,7 +529,7 @@ int esp6_input_done2(struct sk_buff *skb, int err)
 	int hdr_len = skb_network_header_len(skb);
 
 	if (!xo || (xo && !(xo->flags & CRYPTO_DONE)))
-		kfree(ESP_SKB_CB(skb)->tmp);
+		crypto_req_cache_free(&esp_tmp_cache, ESP_SKB_CB(skb)->tmp);
 
 	if (unlikely(err))
 		goto out;
@@ -658,7 +663,7 @@ static int esp6_input(struct xfrm_state *x, struct sk_buff *skb)
 	sg_init_table(sg, nfrags);
 	ret = skb_to_sgvec(skb, sg, 0, skb->len);
 	if (unlikely(ret < 0)) {
-		kfree(tmp);
+		crypto_req_cache_free(&esp_tmp_cache, tmp);
 		goto out;
 	}
 
@@ -916,13 +921,17 @@ static struct xfrm6_protocol esp6_protocol = {
 
 static int __init esp6_init(void)
 {
+	if (crypto_req_cache_init(&esp_tmp_cache, ESP_TMP_CACHE_SIZE))
+		return -ENOMEM;
 	if (xfrm_register_type(&esp6_type, AF_INET6) < 0) {
 		pr_info("%s: can't add xfrm type\n", __func__);
+		crypto_req_cache_destroy(&esp_tmp_cache);
 		return -EAGAIN;
 	}
 	if (xfrm6_protocol_register(&esp6_protocol, IPPROTO_ESP) < 0) {
 		pr_info("%s: can't add protocol\n", __func__);
 		xfrm_unregister_type(&esp6_type, AF_INET6);
+		crypto_req_cache_destroy(&esp_tmp_cache);
 		return -EAGAIN;
 	}
 
@@ -934,6 +943,7 @@ static void __exit esp6_fini(void)
 	if (xfrm6_protocol_deregister(&esp6_protocol, IPPROTO_ESP) < 0)
 		pr_info("%s: can't remove protocol\n", __func__);
 	xfrm_unregister_type(&esp6_type, AF_INET6);
+	crypto_req_cache_destroy(&esp_tmp_cache);
 }
 
 module_init(esp6_init);
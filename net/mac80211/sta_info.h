@@ -129,10 +129,18 @@ enum ieee80211_agg_stop_reason {
 #define AIRTIME_USE_TX		BIT(0)
 #define AIRTIME_USE_RX		BIT(1)
 
+/* Airtime Queue Limits, in usec of estimated airtime queued to the driver */
+#define IEEE80211_DEFAULT_AQL_TXQ_LIMIT_L	5000
+#define IEEE80211_DEFAULT_AQL_TXQ_LIMIT_H	12000
+#define IEEE80211_AQL_THRESHOLD			24000
+
 struct airtime_info {
 	u64 rx_airtime;
 	u64 tx_airtime;
 	s64 deficit;
+	atomic_t aql_tx_pending; /* Estimated airtime for frames pending */
+	u32 aql_limit_low;
+	u32 aql_limit_high;
 };
 
 struct sta_info;
@@ -475,6 +483,9 @@ struct ieee80211_sta_rx_stats {
  * @airtime: per-AC struct airtime_info describing airtime statistics for this
  *	station
  * @airtime_weight: station weight for airtime fairness calculation purposes
+ * @expected_throughput: last expected throughput towards this station in
+ *	kbps, as reported by rate control; used to estimate the airtime of
+ *	frames handed to the driver
  * @ampdu_mlme: A-MPDU state machine state
  * @mesh: mesh STA information
  * @debugfs_dir: debug filesystem directory dentry
@@ -602,6 +613,7 @@ struct sta_info {
 
 	struct airtime_info airtime[IEEE80211_NUM_ACS];
 	u16 airtime_weight;
+	u32 expected_throughput;
 
 	/*
 	 * Aggregation information, locked with lock.
@@ -726,6 +738,10 @@ struct sta_info *sta_info_get(struct ieee80211_sub_if_data *sdata,
 struct sta_info *sta_info_get_bss(struct ieee80211_sub_if_data *sdata,
 				  const u8 *addr);
 
+/* user must hold sta_mtx or be in RCU critical section */
+struct sta_info *sta_info_get_by_addrs(struct ieee80211_local *local,
+				       const u8 *sta_addr, const u8 *vif_addr);
+
 #define for_each_sta_info(local, _addr, _sta, _tmp)			\
 	rhl_for_each_entry_rcu(_sta, _tmp,				\
 			       sta_info_hash_lookup(local, _addr), hash_node)
@@ -789,6 +805,10 @@ void sta_set_sinfo(struct sta_info *sta, struct station_info *sinfo,
 
 u32 sta_get_expected_throughput(struct sta_info *sta);
 
+void ieee80211_sta_update_pending_airtime(struct ieee80211_local *local,
+					  struct sta_info *sta, u8 ac,
+					  u16 tx_airtime, bool tx_completed);
+
 void ieee80211_sta_expire(struct ieee80211_sub_if_data *sdata,
 			  unsigned long exp_time);
 u8 sta_info_tx_streams(struct sta_info *sta);
@@ -461,6 +461,63 @@ static const struct seq_operations ct_cpu_seq_ops = {
 	.show	= ct_cpu_seq_show,
 };
 
+static void *ct_gc_seq_start(struct seq_file *seq, loff_t *pos)
+{
+	struct net *net = seq_file_net(seq);
+	int cpu;
+
+	if (*pos == 0)
+		return SEQ_START_TOKEN;
+
+	for (cpu = *pos-1; cpu < nr_cpu_ids; ++cpu) {
+		if (!cpu_possible(cpu))
+			continue;
+		*pos = cpu + 1;
+		return per_cpu_ptr(net->ct.gc_stat, cpu);
+	}
+
+	return NULL;
+}
+
+static void *ct_gc_seq_next(struct seq_file *seq, void *v, loff_t *pos)
+{
+	struct net *net = seq_file_net(seq);
+	int cpu;
+
+	for (cpu = *pos; cpu < nr_cpu_ids; ++cpu) {
+		if (!cpu_possible(cpu))
+			continue;
+		*pos = cpu + 1;
+		return per_cpu_ptr(net->ct.gc_stat, cpu);
+	}
+	(*pos)++;
+	return NULL;
+}
+
+static int ct_gc_seq_show(struct seq_file *seq, void *v)
+{
+	const struct ct_pcpu_gc_stat *st = v;
+
+	if (v == SEQ_START_TOKEN) {
+		seq_puts(seq, "lock_retry gc_scanned gc_expired gc_lag_ms\n");
+		return 0;
+	}
+
+	seq_printf(seq, "%08x   %08x   %08x   %08x\n",
+		   st->lock_retry,
+		   st->gc_scanned,
+		   st->gc_expired,
+		   st->gc_lag);
+	return 0;
+}
+
+static const struct seq_operations ct_gc_seq_ops = {
+	.start	= ct_gc_seq_start,
+	.next	= ct_gc_seq_next,
+	.stop	= ct_cpu_seq_stop,
+	.show	= ct_gc_seq_show,
+};
+
 static int nf_conntrack_standalone_init_proc(struct net *net)
 {
 	struct proc_dir_entry *pde;
@@ -481,8 +538,15 @@ static int nf_conntrack_standalone_init_proc(struct net *net)
 			&ct_cpu_seq_ops, sizeof(struct seq_net_private));
 	if (!pde)
 		goto out_stat_nf_conntrack;
+
+	pde = proc_create_net("nf_conntrack_gc", 0444, net->proc_net_stat,
+			&ct_gc_seq_ops, sizeof(struct seq_net_private));
+	if (!pde)
+		goto out_stat_nf_conntrack_gc;
 	return 0;
 
+out_stat_nf_conntrack_gc:
+	remove_proc_entry("nf_conntrack", net->proc_net_stat);
 out_stat_nf_conntrack:
 	remove_proc_entry("nf_conntrack", net->proc_net);
 out_nf_conntrack:
@@ -491,6 +555,7 @@ static int nf_conntrack_standalone_init_proc(struct net *net)
 
 static void nf_conntrack_standalone_fini_proc(struct net *net)
 {
+	remove_proc_entry("nf_conntrack_gc", net->proc_net_stat);
 	remove_proc_entry("nf_conntrack", net->proc_net_stat);
 	remove_proc_entry("nf_conntrack", net->proc_net);
 }
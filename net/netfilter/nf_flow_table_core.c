@@ -14,11 +14,7 @@
 #include <net/netfilter/nf_conntrack_l4proto.h>
 #include <net/netfilter/nf_conntrack_tuple.h>
 
-struct flow_offload_entry {
-	struct flow_offload	flow;
-	struct nf_conn		*ct;
-	struct rcu_head		rcu_head;
-};
+#include "nf_flow_table_internal.h"
 
 static DEFINE_MUTEX(flowtable_lock);
 static LIST_HEAD(flowtables);
@@ -39,12 +35,14 @@ flow_offload_fill_dir(struct flow_offload *flow, struct nf_conn *ct,
 	case NFPROTO_IPV4:
 		ft->src_v4 = ctt->src.u3.in;
 		ft->dst_v4 = ctt->dst.u3.in;
-		ft->mtu = ip_dst_mtu_maybe_forward(dst, true);
+		if (dst)
+			ft->mtu = ip_dst_mtu_maybe_forward(dst, true);
 		break;
 	case NFPROTO_IPV6:
 		ft->src_v6 = ctt->src.u3.in6;
 		ft->dst_v6 = ctt->dst.u3.in6;
-		ft->mtu = ip6_dst_mtu_forward(dst);
+		if (dst)
+			ft->mtu = ip6_dst_mtu_forward(dst);
 		break;
 	}
 
@@ -53,10 +51,19 @@ flow_offload_fill_dir(struct flow_offload *flow, struct nf_conn *ct,
 	ft->src_port = ctt->src.u.tcp.port;
 	ft->dst_port = ctt->dst.u.tcp.port;
 
-	ft->iifidx = other_dst->dev->ifindex;
+	/* Bridged flows have no route, their devices are set up through
+	 * flow_offload_set_xmit().
+	 */
+	if (other_dst)
+		ft->iifidx = other_dst->dev->ifindex;
 	ft->dst_cache = dst;
 }
 
+static bool flow_offload_dst_hold(struct dst_entry *dst)
+{
+	return !dst || dst_hold_safe(dst);
+}
+
 struct flow_offload *
 flow_offload_alloc(struct nf_conn *ct, struct nf_flow_route *route)
 {
@@ -73,10 +80,10 @@ flow_offload_alloc(struct nf_conn *ct, struct nf_flow_route *route)
 
 	flow = &entry->flow;
 
-	if (!dst_hold_safe(route->tuple[FLOW_OFFLOAD_DIR_ORIGINAL].dst))
+	if (!flow_offload_dst_hold(route->tuple[FLOW_OFFLOAD_DIR_ORIGINAL].dst))
 		goto err_dst_cache_original;
 
-	if (!dst_hold_safe(route->tuple[FLOW_OFFLOAD_DIR_REPLY].dst))
+	if (!flow_offload_dst_hold(route->tuple[FLOW_OFFLOAD_DIR_REPLY].dst))
 		goto err_dst_cache_reply;
 
 	entry->ct = ct;
@@ -102,6 +109,15 @@ flow_offload_alloc(struct nf_conn *ct, struct nf_flow_route *route)
 }
 EXPORT_SYMBOL_GPL(flow_offload_alloc);
 
+void flow_offload_set_xmit(struct flow_offload *flow,
+			   enum flow_offload_tuple_dir dir,
+			   const struct flow_offload_xmit *xmit)
+{
+	flow_offload_entry(flow)->xmit[dir] = *xmit;
+	flow->tuplehash[!dir].tuple.iifidx = xmit->ifidx;
+}
+EXPORT_SYMBOL_GPL(flow_offload_set_xmit);
+
 static void flow_offload_fixup_tcp(struct ip_ct_tcp *tcp)
 {
 	tcp->state = TCP_CONNTRACK_ESTABLISHED;
@@ -482,6 +498,13 @@ int nf_flow_table_init(struct nf_flowtable *flowtable)
 }
 EXPORT_SYMBOL_GPL(nf_flow_table_init);
 
+static bool flow_offload_tuple_uses_dev(const struct flow_offload_tuple *tuple,
+					const struct net_device *dev)
+{
+	return tuple->iifidx == dev->ifindex ||
+	       (tuple->dst_cache && tuple->dst_cache->dev == dev);
+}
+
 static void nf_flow_table_do_cleanup(struct flow_offload *flow, void *data)
 {
 	struct net_device *dev = data;
@@ -494,8 +517,8 @@ static void nf_flow_table_do_cleanup(struct flow_offload *flow, void *data)
 		return;
 	}
 	if (net_eq(nf_ct_net(e->ct), dev_net(dev)) &&
-	    (flow->tuplehash[0].tuple.iifidx == dev->ifindex ||
-	     flow->tuplehash[1].tuple.iifidx == dev->ifindex))
+	    (flow_offload_tuple_uses_dev(&flow->tuplehash[0].tuple, dev) ||
+	     flow_offload_tuple_uses_dev(&flow->tuplehash[1].tuple, dev)))
 		flow_offload_dead(flow);
 }
 
@@ -529,5 +552,44 @@ void nf_flow_table_free(struct nf_flowtable *flow_table)
 }
 EXPORT_SYMBOL_GPL(nf_flow_table_free);
 
+static int nf_flow_table_init_net(struct net *net)
+{
+	int ret;
+
+	net->ft.stat = alloc_percpu(struct nf_flow_table_stat);
+	if (!net->ft.stat)
+		return -ENOMEM;
+
+	ret = nf_flow_table_init_proc(net);
+	if (ret < 0)
+		free_percpu(net->ft.stat);
+
+	return ret;
+}
+
+static void nf_flow_table_exit_net(struct net *net)
+{
+	nf_flow_table_fini_proc(net);
+	free_percpu(net->ft.stat);
+}
+
+static struct pernet_operations nf_flow_table_net_ops = {
+	.init	= nf_flow_table_init_net,
+	.exit	= nf_flow_table_exit_net,
+};
+
+static int __init nf_flow_table_module_init(void)
+{
+	return register_pernet_subsys(&nf_flow_table_net_ops);
+}
+
+static void __exit nf_flow_table_module_exit(void)
+{
+	unregister_pernet_subsys(&nf_flow_table_net_ops);
+}
+
+module_init(nf_flow_table_module_init);
+module_exit(nf_flow_table_module_exit);
+
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Pablo Neira Ayuso <pablo@netfilter.org>");
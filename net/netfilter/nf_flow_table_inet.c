@@ -7,11 +7,13 @@
 #include <net/netfilter/nf_flow_table.h>
 #include <net/netfilter/nf_tables.h>
 
+#include "nf_flow_table_internal.h"
+
 static unsigned int
 nf_flow_offload_inet_hook(void *priv, struct sk_buff *skb,
 			  const struct nf_hook_state *state)
 {
-	switch (skb->protocol) {
+	switch (nf_flow_skb_proto(skb)) {
 	case htons(ETH_P_IP):
 		return nf_flow_offload_ip_hook(priv, skb, state);
 	case htons(ETH_P_IPV6):
@@ -29,15 +31,25 @@ static struct nf_flowtable_type flowtable_inet = {
 	.owner		= THIS_MODULE,
 };
 
+static struct nf_flowtable_type flowtable_bridge = {
+	.family		= NFPROTO_BRIDGE,
+	.init		= nf_flow_table_init,
+	.free		= nf_flow_table_free,
+	.hook		= nf_flow_offload_inet_hook,
+	.owner		= THIS_MODULE,
+};
+
 static int __init nf_flow_inet_module_init(void)
 {
 	nft_register_flowtable_type(&flowtable_inet);
+	nft_register_flowtable_type(&flowtable_bridge);
 
 	return 0;
 }
 
 static void __exit nf_flow_inet_module_exit(void)
 {
+	nft_unregister_flowtable_type(&flowtable_bridge);
 	nft_unregister_flowtable_type(&flowtable_inet);
 }
 
@@ -47,3 +59,4 @@ module_exit(nf_flow_inet_module_exit);
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Pablo Neira Ayuso <pablo@netfilter.org>");
 MODULE_ALIAS_NF_FLOWTABLE(1); /* NFPROTO_INET */
+MODULE_ALIAS_NF_FLOWTABLE(7); /* NFPROTO_BRIDGE */
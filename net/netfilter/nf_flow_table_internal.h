@@ -0,0 +1,94 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _NF_FLOW_TABLE_INTERNAL_H
+#define _NF_FLOW_TABLE_INTERNAL_H
+
+#include <linux/if_ether.h>
+#include <net/netfilter/nf_flow_table.h>
+
+#define NF_FLOW_TABLE_ENCAP_MAX		2
+
+enum flow_offload_xmit_type {
+	FLOW_OFFLOAD_XMIT_NEIGH		= 0,
+	FLOW_OFFLOAD_XMIT_DIRECT,
+};
+
+struct flow_offload_encap {
+	u16			id;
+	__be16			proto;
+};
+
+/* How packets of one direction leave the box. For direct transmission
+ * the output is the real device below any bridge, VLAN or PPPoE device
+ * the route points to, and the encapsulation of those devices is pushed
+ * by the flowtable itself. Packets of the other direction arrive on that
+ * same device carrying the same encapsulation.
+ */
+struct flow_offload_xmit {
+	u8				type;
+	u8				encap_num;
+	/* Outermost first, as seen on the wire */
+	struct flow_offload_encap	encap[NF_FLOW_TABLE_ENCAP_MAX];
+	int				ifidx;
+	u8				h_source[ETH_ALEN];
+	u8				h_dest[ETH_ALEN];
+};
+
+struct flow_offload_entry {
+	struct flow_offload		flow;
+	struct nf_conn			*ct;
+	/* Bridged flow, there is no route and TTL is left alone */
+	bool				bridged;
+	struct flow_offload_xmit	xmit[FLOW_OFFLOAD_DIR_MAX];
+	struct rcu_head			rcu_head;
+};
+
+static inline struct flow_offload_entry *
+flow_offload_entry(const struct flow_offload *flow)
+{
+	return container_of(flow, struct flow_offload_entry, flow);
+}
+
+static inline struct flow_offload_xmit *
+flow_offload_xmit(const struct flow_offload *flow,
+		  enum flow_offload_tuple_dir dir)
+{
+	return &flow_offload_entry(flow)->xmit[dir];
+}
+
+/* Encapsulation found in front of a received packet */
+struct nf_flow_encap_info {
+	struct flow_offload_encap	encap[NF_FLOW_TABLE_ENCAP_MAX];
+	u8				num;
+	/* Network header of the inner packet, relative to skb->data */
+	unsigned int			offset;
+	__be16				proto;
+};
+
+__be16 nf_flow_skb_proto(const struct sk_buff *skb);
+
+/* Route one direction of @flow directly to @xmit, packets of the other
+ * direction are then expected on xmit->ifidx. Must be called before
+ * flow_offload_add().
+ */
+void flow_offload_set_xmit(struct flow_offload *flow,
+			   enum flow_offload_tuple_dir dir,
+			   const struct flow_offload_xmit *xmit);
+
+#define NF_FLOW_TABLE_STAT_INC(net, count) \
+	__this_cpu_inc((net)->ft.stat->count)
+
+#ifdef CONFIG_PROC_FS
+int nf_flow_table_init_proc(struct net *net);
+void nf_flow_table_fini_proc(struct net *net);
+#else
+static inline int nf_flow_table_init_proc(struct net *net)
+{
+	return 0;
+}
+
+static inline void nf_flow_table_fini_proc(struct net *net)
+{
+}
+#endif
+
+#endif
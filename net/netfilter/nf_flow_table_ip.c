@@ -7,6 +7,9 @@
 #include <linux/ip.h>
 #include <linux/ipv6.h>
 #include <linux/netdevice.h>
+#include <linux/if_vlan.h>
+#include <linux/if_pppox.h>
+#include <linux/ppp_defs.h>
 #include <net/ip.h>
 #include <net/ipv6.h>
 #include <net/ip6_route.h>
@@ -15,6 +18,244 @@
 /* For layer 4 checksum field offset. */
 #include <linux/tcp.h>
 #include <linux/udp.h>
+#include <asm/unaligned.h>
+
+#include "nf_flow_table_internal.h"
+
+static __be16 nf_flow_ppp_proto(__be16 proto)
+{
+	switch (proto) {
+	case htons(PPP_IP):
+		return htons(ETH_P_IP);
+	case htons(PPP_IPV6):
+		return htons(ETH_P_IPV6);
+	}
+
+	return 0;
+}
+
+/* Collect the VLAN tags and PPPoE session headers in front of the network
+ * header, outermost first. They are still in place when the flowtable
+ * hook is attached to the real device below VLAN and PPPoE devices.
+ */
+static int nf_flow_skb_encap(const struct sk_buff *skb,
+			     struct nf_flow_encap_info *info)
+{
+	struct flow_offload_encap *encap;
+	__be16 proto = skb->protocol;
+
+	info->num = 0;
+	info->offset = 0;
+
+	if (skb_vlan_tag_present(skb)) {
+		encap = &info->encap[info->num++];
+		encap->id = skb_vlan_tag_get_id(skb);
+		encap->proto = skb->vlan_proto;
+	}
+
+	while (proto == htons(ETH_P_8021Q) || proto == htons(ETH_P_8021AD) ||
+	       proto == htons(ETH_P_PPP_SES)) {
+		if (info->num == NF_FLOW_TABLE_ENCAP_MAX)
+			return -1;
+
+		encap = &info->encap[info->num++];
+		encap->proto = proto;
+
+		if (proto == htons(ETH_P_PPP_SES)) {
+			u8 _buf[PPPOE_SES_HLEN];
+			const struct pppoe_hdr *ph;
+
+			ph = skb_header_pointer(skb, info->offset,
+						PPPOE_SES_HLEN, _buf);
+			if (!ph || ph->code)
+				return -1;
+
+			encap->id = ntohs(ph->sid);
+			proto = nf_flow_ppp_proto(get_unaligned((__be16 *)(ph + 1)));
+			info->offset += PPPOE_SES_HLEN;
+		} else {
+			const struct vlan_hdr *vhdr;
+			struct vlan_hdr _vhdr;
+
+			vhdr = skb_header_pointer(skb, info->offset,
+						  sizeof(_vhdr), &_vhdr);
+			if (!vhdr)
+				return -1;
+
+			encap->id = ntohs(vhdr->h_vlan_TCI) & VLAN_VID_MASK;
+			proto = vhdr->h_vlan_encapsulated_proto;
+			info->offset += VLAN_HLEN;
+		}
+	}
+	info->proto = proto;
+
+	return 0;
+}
+
+__be16 nf_flow_skb_proto(const struct sk_buff *skb)
+{
+	struct nf_flow_encap_info info;
+
+	if (nf_flow_skb_encap(skb, &info) < 0)
+		return 0;
+
+	return info.proto;
+}
+EXPORT_SYMBOL_GPL(nf_flow_skb_proto);
+
+/* Packets of one direction arrive wrapped the way the other direction
+ * is sent out.
+ */
+static bool nf_flow_encap_match(const struct flow_offload *flow,
+				enum flow_offload_tuple_dir dir,
+				const struct nf_flow_encap_info *info)
+{
+	const struct flow_offload_xmit *other = flow_offload_xmit(flow, !dir);
+
+	return other->encap_num == info->num &&
+	       !memcmp(other->encap, info->encap,
+		       info->num * sizeof(info->encap[0]));
+}
+
+static void nf_flow_encap_pop(struct sk_buff *skb,
+			      const struct nf_flow_encap_info *info)
+{
+	struct vlan_hdr *vhdr;
+	int i;
+
+	for (i = 0; i < info->num; i++) {
+		if (skb_vlan_tag_present(skb)) {
+			__vlan_hwaccel_clear_tag(skb);
+			continue;
+		}
+
+		switch (skb->protocol) {
+		case htons(ETH_P_8021Q):
+		case htons(ETH_P_8021AD):
+			vhdr = (struct vlan_hdr *)skb->data;
+			__skb_pull(skb, VLAN_HLEN);
+			vlan_set_encap_proto(skb, vhdr);
+			break;
+		case htons(ETH_P_PPP_SES):
+			skb->protocol = nf_flow_ppp_proto(get_unaligned(
+				(__be16 *)(skb->data + sizeof(struct pppoe_hdr))));
+			__skb_pull(skb, PPPOE_SES_HLEN);
+			break;
+		}
+		skb_reset_network_header(skb);
+	}
+}
+
+static int nf_flow_vlan_push(struct sk_buff *skb, __be16 proto, u16 id)
+{
+	struct vlan_hdr *vhdr;
+
+	if (skb_cow_head(skb, VLAN_HLEN))
+		return -1;
+
+	vhdr = (struct vlan_hdr *)__skb_push(skb, VLAN_HLEN);
+	vhdr->h_vlan_TCI = htons(id);
+	vhdr->h_vlan_encapsulated_proto = skb->protocol;
+	skb->protocol = proto;
+	skb_reset_network_header(skb);
+
+	return 0;
+}
+
+static int nf_flow_pppoe_push(struct sk_buff *skb, u16 id)
+{
+	int data_len = skb->len + sizeof(__be16);
+	struct pppoe_hdr *ph;
+	__be16 proto;
+
+	switch (skb->protocol) {
+	case htons(ETH_P_IP):
+		proto = htons(PPP_IP);
+		break;
+	case htons(ETH_P_IPV6):
+		proto = htons(PPP_IPV6);
+		break;
+	default:
+		return -1;
+	}
+
+	if (skb_cow_head(skb, PPPOE_SES_HLEN))
+		return -1;
+
+	ph = (struct pppoe_hdr *)__skb_push(skb, PPPOE_SES_HLEN);
+	ph->ver = 1;
+	ph->type = 1;
+	ph->code = 0;
+	ph->sid = htons(id);
+	ph->length = htons(data_len);
+	put_unaligned(proto, (__be16 *)(ph + 1));
+	skb->protocol = htons(ETH_P_PPP_SES);
+	skb_reset_network_header(skb);
+
+	return 0;
+}
+
+static int nf_flow_encap_push(struct sk_buff *skb,
+			      const struct flow_offload_xmit *xmit)
+{
+	const struct flow_offload_encap *encap;
+	int i;
+
+	/* Innermost first. The outermost VLAN tag is left to the device
+	 * as a hardware accelerated tag.
+	 */
+	for (i = xmit->encap_num - 1; i >= 0; i--) {
+		encap = &xmit->encap[i];
+
+		switch (encap->proto) {
+		case htons(ETH_P_8021Q):
+		case htons(ETH_P_8021AD):
+			if (i == 0) {
+				__vlan_hwaccel_put_tag(skb, encap->proto,
+						       encap->id);
+				break;
+			}
+			if (nf_flow_vlan_push(skb, encap->proto, encap->id) < 0)
+				return -1;
+			break;
+		case htons(ETH_P_PPP_SES):
+			if (nf_flow_pppoe_push(skb, encap->id) < 0)
+				return -1;
+			break;
+		default:
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* Send out on the real device with a cached link layer header, bypassing
+ * the bridge, VLAN and PPPoE devices stacked on top of it.
+ */
+static unsigned int nf_flow_xmit_direct(struct net *net, struct sk_buff *skb,
+					const struct flow_offload_xmit *xmit)
+{
+	struct net_device *outdev;
+
+	outdev = dev_get_by_index_rcu(net, xmit->ifidx);
+	if (!outdev)
+		return NF_DROP;
+
+	if (nf_flow_encap_push(skb, xmit) < 0 ||
+	    skb_cow_head(skb, LL_RESERVED_SPACE(outdev)))
+		return NF_DROP;
+
+	skb->dev = outdev;
+	if (dev_hard_header(skb, outdev, ntohs(skb->protocol), xmit->h_dest,
+			    xmit->h_source, skb->len) < 0)
+		return NF_DROP;
+
+	NF_FLOW_TABLE_STAT_INC(net, xmit_direct);
+	dev_queue_xmit(skb);
+
+	return NF_STOLEN;
+}
 
 static int nf_flow_state_check(struct flow_offload *flow, int proto,
 			       struct sk_buff *skb, unsigned int thoff)
@@ -162,16 +403,17 @@ static bool ip_has_options(unsigned int thoff)
 }
 
 static int nf_flow_tuple_ip(struct sk_buff *skb, const struct net_device *dev,
-			    struct flow_offload_tuple *tuple)
+			    struct flow_offload_tuple *tuple,
+			    unsigned int offset)
 {
 	struct flow_ports *ports;
 	unsigned int thoff;
 	struct iphdr *iph;
 
-	if (!pskb_may_pull(skb, sizeof(*iph)))
+	if (!pskb_may_pull(skb, offset + sizeof(*iph)))
 		return -1;
 
-	iph = ip_hdr(skb);
+	iph = (struct iphdr *)(skb_network_header(skb) + offset);
 	thoff = iph->ihl * 4;
 
 	if (ip_is_fragment(iph) ||
@@ -186,11 +428,11 @@ static int nf_flow_tuple_ip(struct sk_buff *skb, const struct net_device *dev,
 		return -1;
 
 	thoff = iph->ihl * 4;
-	if (!pskb_may_pull(skb, thoff + sizeof(*ports)))
+	if (!pskb_may_pull(skb, offset + thoff + sizeof(*ports)))
 		return -1;
 
-	iph = ip_hdr(skb);
-	ports = (struct flow_ports *)(skb_network_header(skb) + thoff);
+	iph = (struct iphdr *)(skb_network_header(skb) + offset);
+	ports = (struct flow_ports *)(skb_network_header(skb) + offset + thoff);
 
 	tuple->src_v4.s_addr	= iph->saddr;
 	tuple->dst_v4.s_addr	= iph->daddr;
@@ -240,6 +482,8 @@ nf_flow_offload_ip_hook(void *priv, struct sk_buff *skb,
 	struct flow_offload_tuple_rhash *tuplehash;
 	struct nf_flowtable *flow_table = priv;
 	struct flow_offload_tuple tuple = {};
+	const struct flow_offload_xmit *xmit;
+	struct nf_flow_encap_info encap;
 	enum flow_offload_tuple_dir dir;
 	struct flow_offload *flow;
 	struct net_device *outdev;
@@ -248,43 +492,56 @@ nf_flow_offload_ip_hook(void *priv, struct sk_buff *skb,
 	struct iphdr *iph;
 	__be32 nexthop;
 
-	if (skb->protocol != htons(ETH_P_IP))
+	if (nf_flow_skb_encap(skb, &encap) < 0 ||
+	    encap.proto != htons(ETH_P_IP))
 		return NF_ACCEPT;
 
-	if (nf_flow_tuple_ip(skb, state->in, &tuple) < 0)
+	if (nf_flow_tuple_ip(skb, state->in, &tuple, encap.offset) < 0)
 		return NF_ACCEPT;
 
 	tuplehash = flow_offload_lookup(flow_table, &tuple);
 	if (tuplehash == NULL)
-		return NF_ACCEPT;
+		goto miss;
 
 	dir = tuplehash->tuple.dir;
 	flow = container_of(tuplehash, struct flow_offload, tuplehash[dir]);
+	if (!nf_flow_encap_match(flow, dir, &encap))
+		goto miss;
+
+	xmit = flow_offload_xmit(flow, dir);
 	rt = (struct rtable *)flow->tuplehash[dir].tuple.dst_cache;
-	outdev = rt->dst.dev;
 
-	if (unlikely(nf_flow_exceeds_mtu(skb, flow->tuplehash[dir].tuple.mtu)))
-		return NF_ACCEPT;
+	if (unlikely(nf_flow_exceeds_mtu(skb, flow->tuplehash[dir].tuple.mtu +
+					      encap.offset)))
+		goto slowpath;
 
-	if (skb_try_make_writable(skb, sizeof(*iph)))
+	if (skb_try_make_writable(skb, encap.offset + sizeof(*iph)))
 		return NF_DROP;
 
-	thoff = ip_hdr(skb)->ihl * 4;
-	if (nf_flow_state_check(flow, ip_hdr(skb)->protocol, skb, thoff))
-		return NF_ACCEPT;
+	iph = (struct iphdr *)(skb_network_header(skb) + encap.offset);
+	thoff = iph->ihl * 4;
+	if (nf_flow_state_check(flow, iph->protocol, skb, encap.offset + thoff))
+		goto slowpath;
 
-	if (nf_flow_offload_dst_check(&rt->dst)) {
+	if (rt && nf_flow_offload_dst_check(&rt->dst)) {
 		flow_offload_teardown(flow);
-		return NF_ACCEPT;
+		goto slowpath;
 	}
 
+	nf_flow_encap_pop(skb, &encap);
+
 	if (nf_flow_nat_ip(flow, skb, thoff, dir) < 0)
 		return NF_DROP;
 
 	flow->timeout = (u32)jiffies + NF_FLOW_TIMEOUT;
 	iph = ip_hdr(skb);
-	ip_decrease_ttl(iph);
+	if (!flow_offload_entry(flow)->bridged)
+		ip_decrease_ttl(iph);
 	skb->tstamp = 0;
+	NF_FLOW_TABLE_STAT_INC(state->net, found);
+
+	if (xmit->type == FLOW_OFFLOAD_XMIT_DIRECT)
+		return nf_flow_xmit_direct(state->net, skb, xmit);
 
 	if (unlikely(dst_xfrm(&rt->dst))) {
 		memset(skb->cb, 0, sizeof(struct inet_skb_parm));
@@ -293,12 +550,21 @@ nf_flow_offload_ip_hook(void *priv, struct sk_buff *skb,
 		return nf_flow_xmit_xfrm(skb, state, &rt->dst);
 	}
 
+	outdev = rt->dst.dev;
 	skb->dev = outdev;
 	nexthop = rt_nexthop(rt, flow->tuplehash[!dir].tuple.src_v4.s_addr);
 	skb_dst_set_noref(skb, &rt->dst);
+	NF_FLOW_TABLE_STAT_INC(state->net, xmit_neigh);
 	neigh_xmit(NEIGH_ARP_TABLE, outdev, &nexthop, skb);
 
 	return NF_STOLEN;
+
+miss:
+	NF_FLOW_TABLE_STAT_INC(state->net, miss);
+	return NF_ACCEPT;
+slowpath:
+	NF_FLOW_TABLE_STAT_INC(state->net, slowpath);
+	return NF_ACCEPT;
 }
 EXPORT_SYMBOL_GPL(nf_flow_offload_ip_hook);
 
@@ -428,16 +694,17 @@ static int nf_flow_nat_ipv6(const struct flow_offload *flow,
 }
 
 static int nf_flow_tuple_ipv6(struct sk_buff *skb, const struct net_device *dev,
-			      struct flow_offload_tuple *tuple)
+			      struct flow_offload_tuple *tuple,
+			      unsigned int offset)
 {
 	struct flow_ports *ports;
 	struct ipv6hdr *ip6h;
 	unsigned int thoff;
 
-	if (!pskb_may_pull(skb, sizeof(*ip6h)))
+	if (!pskb_may_pull(skb, offset + sizeof(*ip6h)))
 		return -1;
 
-	ip6h = ipv6_hdr(skb);
+	ip6h = (struct ipv6hdr *)(skb_network_header(skb) + offset);
 
 	if (ip6h->nexthdr != IPPROTO_TCP &&
 	    ip6h->nexthdr != IPPROTO_UDP)
@@ -446,11 +713,11 @@ static int nf_flow_tuple_ipv6(struct sk_buff *skb, const struct net_device *dev,
 	if (ip6h->hop_limit <= 1)
 		return -1;
 
-	thoff = sizeof(*ip6h);
+	thoff = offset + sizeof(*ip6h);
 	if (!pskb_may_pull(skb, thoff + sizeof(*ports)))
 		return -1;
 
-	ip6h = ipv6_hdr(skb);
+	ip6h = (struct ipv6hdr *)(skb_network_header(skb) + offset);
 	ports = (struct flow_ports *)(skb_network_header(skb) + thoff);
 
 	tuple->src_v6		= ip6h->saddr;
@@ -471,6 +738,8 @@ nf_flow_offload_ipv6_hook(void *priv, struct sk_buff *skb,
 	struct flow_offload_tuple_rhash *tuplehash;
 	struct nf_flowtable *flow_table = priv;
 	struct flow_offload_tuple tuple = {};
+	const struct flow_offload_xmit *xmit;
+	struct nf_flow_encap_info encap;
 	enum flow_offload_tuple_dir dir;
 	const struct in6_addr *nexthop;
 	struct flow_offload *flow;
@@ -478,43 +747,56 @@ nf_flow_offload_ipv6_hook(void *priv, struct sk_buff *skb,
 	struct ipv6hdr *ip6h;
 	struct rt6_info *rt;
 
-	if (skb->protocol != htons(ETH_P_IPV6))
+	if (nf_flow_skb_encap(skb, &encap) < 0 ||
+	    encap.proto != htons(ETH_P_IPV6))
 		return NF_ACCEPT;
 
-	if (nf_flow_tuple_ipv6(skb, state->in, &tuple) < 0)
+	if (nf_flow_tuple_ipv6(skb, state->in, &tuple, encap.offset) < 0)
 		return NF_ACCEPT;
 
 	tuplehash = flow_offload_lookup(flow_table, &tuple);
 	if (tuplehash == NULL)
-		return NF_ACCEPT;
+		goto miss;
 
 	dir = tuplehash->tuple.dir;
 	flow = container_of(tuplehash, struct flow_offload, tuplehash[dir]);
+	if (!nf_flow_encap_match(flow, dir, &encap))
+		goto miss;
+
+	xmit = flow_offload_xmit(flow, dir);
 	rt = (struct rt6_info *)flow->tuplehash[dir].tuple.dst_cache;
-	outdev = rt->dst.dev;
 
-	if (unlikely(nf_flow_exceeds_mtu(skb, flow->tuplehash[dir].tuple.mtu)))
-		return NF_ACCEPT;
+	if (unlikely(nf_flow_exceeds_mtu(skb, flow->tuplehash[dir].tuple.mtu +
+					      encap.offset)))
+		goto slowpath;
 
-	if (nf_flow_state_check(flow, ipv6_hdr(skb)->nexthdr, skb,
-				sizeof(*ip6h)))
-		return NF_ACCEPT;
+	ip6h = (struct ipv6hdr *)(skb_network_header(skb) + encap.offset);
+	if (nf_flow_state_check(flow, ip6h->nexthdr, skb,
+				encap.offset + sizeof(*ip6h)))
+		goto slowpath;
 
-	if (nf_flow_offload_dst_check(&rt->dst)) {
+	if (rt && nf_flow_offload_dst_check(&rt->dst)) {
 		flow_offload_teardown(flow);
-		return NF_ACCEPT;
+		goto slowpath;
 	}
 
-	if (skb_try_make_writable(skb, sizeof(*ip6h)))
+	if (skb_try_make_writable(skb, encap.offset + sizeof(*ip6h)))
 		return NF_DROP;
 
+	nf_flow_encap_pop(skb, &encap);
+
 	if (nf_flow_nat_ipv6(flow, skb, dir) < 0)
 		return NF_DROP;
 
 	flow->timeout = (u32)jiffies + NF_FLOW_TIMEOUT;
 	ip6h = ipv6_hdr(skb);
-	ip6h->hop_limit--;
+	if (!flow_offload_entry(flow)->bridged)
+		ip6h->hop_limit--;
 	skb->tstamp = 0;
+	NF_FLOW_TABLE_STAT_INC(state->net, found);
+
+	if (xmit->type == FLOW_OFFLOAD_XMIT_DIRECT)
+		return nf_flow_xmit_direct(state->net, skb, xmit);
 
 	if (unlikely(dst_xfrm(&rt->dst))) {
 		memset(skb->cb, 0, sizeof(struct inet6_skb_parm));
@@ -523,11 +805,20 @@ nf_flow_offload_ipv6_hook(void *priv, struct sk_buff *skb,
 		return nf_flow_xmit_xfrm(skb, state, &rt->dst);
 	}
 
+	outdev = rt->dst.dev;
 	skb->dev = outdev;
 	nexthop = rt6_nexthop(rt, &flow->tuplehash[!dir].tuple.src_v6);
 	skb_dst_set_noref(skb, &rt->dst);
+	NF_FLOW_TABLE_STAT_INC(state->net, xmit_neigh);
 	neigh_xmit(NEIGH_ND_TABLE, outdev, nexthop, skb);
 
 	return NF_STOLEN;
+
+miss:
+	NF_FLOW_TABLE_STAT_INC(state->net, miss);
+	return NF_ACCEPT;
+slowpath:
+	NF_FLOW_TABLE_STAT_INC(state->net, slowpath);
+	return NF_ACCEPT;
 }
 EXPORT_SYMBOL_GPL(nf_flow_offload_ipv6_hook);
@@ -6,6 +6,9 @@
 #include <linux/netfilter.h>
 #include <linux/workqueue.h>
 #include <linux/spinlock.h>
+#include <linux/etherdevice.h>
+#include <linux/if_arp.h>
+#include <linux/if_vlan.h>
 #include <linux/netfilter/nf_conntrack_common.h>
 #include <linux/netfilter/nf_tables.h>
 #include <net/ip.h> /* for ipv4 options. */
@@ -15,6 +18,8 @@
 #include <net/netfilter/nf_conntrack_extend.h>
 #include <net/netfilter/nf_flow_table.h>
 
+#include "nf_flow_table_internal.h"
+
 struct nft_flow_offload {
 	struct nft_flowtable	*flowtable;
 };
@@ -50,6 +55,159 @@ static int nft_flow_route(const struct nft_pktinfo *pkt,
 	return 0;
 }
 
+static bool nft_flowtable_has_dev(const struct nft_flowtable *flowtable,
+				  const struct net_device *dev)
+{
+	int i;
+
+	for (i = 0; i < flowtable->ops_len; i++) {
+		if (flowtable->ops[i].dev == dev)
+			return true;
+	}
+
+	return false;
+}
+
+/* Look through the bridge, VLAN and PPPoE devices the route for @dir
+ * points to. If packets can be sent on the real device below them and the
+ * flowtable also sees the packets of the other direction there, set up
+ * @xmit to transmit directly. Otherwise the flow is sent through the
+ * neighbour layer to the routing device, as for plain Ethernet.
+ */
+static bool nft_flow_route_direct(const struct nft_flowtable *flowtable,
+				  const struct nf_conn *ct,
+				  enum ip_conntrack_dir dir,
+				  struct dst_entry *dst,
+				  struct flow_offload_xmit *xmit)
+{
+	const void *daddr = &ct->tuplehash[!dir].tuple.src.u3;
+	struct net_device_path_stack stack;
+	const struct net_device_path *path;
+	const struct net_device *dev;
+	struct neighbour *n;
+	u8 ha[ETH_ALEN];
+	u8 nud_state;
+	int i;
+
+	if (dst_xfrm(dst))
+		return false;
+
+	n = dst_neigh_lookup(dst, daddr);
+	if (!n)
+		return false;
+
+	read_lock_bh(&n->lock);
+	nud_state = n->nud_state;
+	ether_addr_copy(ha, n->ha);
+	read_unlock_bh(&n->lock);
+	neigh_release(n);
+
+	if (!(nud_state & NUD_VALID))
+		return false;
+
+	if (dev_fill_forward_path(dst->dev, ha, &stack) < 0 ||
+	    stack.num_paths < 2)
+		return false;
+
+	memset(xmit, 0, sizeof(*xmit));
+	ether_addr_copy(xmit->h_dest, ha);
+
+	for (i = 0; i < stack.num_paths; i++) {
+		path = &stack.path[i];
+
+		if (is_zero_ether_addr(xmit->h_source) &&
+		    path->dev->addr_len == ETH_ALEN)
+			ether_addr_copy(xmit->h_source, path->dev->dev_addr);
+
+		switch (path->type) {
+		case DEV_PATH_VLAN:
+		case DEV_PATH_PPPOE:
+			if (xmit->encap_num == NF_FLOW_TABLE_ENCAP_MAX)
+				return false;
+
+			/* The path is walked from the top down, so each
+			 * header found goes outside the previous ones.
+			 */
+			memmove(&xmit->encap[1], &xmit->encap[0],
+				xmit->encap_num * sizeof(xmit->encap[0]));
+			xmit->encap[0].id = path->encap.id;
+			xmit->encap[0].proto = path->encap.proto;
+			xmit->encap_num++;
+
+			if (path->type == DEV_PATH_PPPOE)
+				ether_addr_copy(xmit->h_dest,
+						path->encap.h_dest);
+			break;
+		case DEV_PATH_BRIDGE:
+		case DEV_PATH_ETHERNET:
+			break;
+		}
+	}
+
+	dev = stack.path[stack.num_paths - 1].dev;
+	if (dev->type != ARPHRD_ETHER ||
+	    !nft_flowtable_has_dev(flowtable, dev))
+		return false;
+
+	xmit->type = FLOW_OFFLOAD_XMIT_DIRECT;
+	xmit->ifidx = dev->ifindex;
+
+	return true;
+}
+
+static void nft_flow_route_xmit(const struct nft_flowtable *flowtable,
+				const struct nf_conn *ct,
+				struct nf_flow_route *route,
+				struct flow_offload *flow)
+{
+	struct flow_offload_xmit xmit;
+	enum ip_conntrack_dir dir;
+
+	for (dir = IP_CT_DIR_ORIGINAL; dir < IP_CT_DIR_MAX; dir++) {
+		if (nft_flow_route_direct(flowtable, ct, dir,
+					  route->tuple[dir].dst, &xmit))
+			flow_offload_set_xmit(flow, dir, &xmit);
+	}
+}
+
+/* Bridged packets are sent back out with their original Ethernet header
+ * on the port the bridge forwarded them to.
+ */
+static int nft_flow_bridge_xmit(const struct nft_pktinfo *pkt,
+				const struct nft_flowtable *flowtable,
+				struct flow_offload *flow,
+				enum ip_conntrack_dir dir)
+{
+	const struct net_device *in = nft_in(pkt), *out = nft_out(pkt);
+	struct flow_offload_xmit xmit = {
+		.type	= FLOW_OFFLOAD_XMIT_DIRECT,
+	};
+	const struct ethhdr *eth;
+
+	if (skb_vlan_tag_present(pkt->skb) ||
+	    !nft_flowtable_has_dev(flowtable, in) ||
+	    !nft_flowtable_has_dev(flowtable, out))
+		return -1;
+
+	eth = eth_hdr(pkt->skb);
+
+	xmit.ifidx = out->ifindex;
+	ether_addr_copy(xmit.h_source, eth->h_source);
+	ether_addr_copy(xmit.h_dest, eth->h_dest);
+	flow_offload_set_xmit(flow, dir, &xmit);
+	flow->tuplehash[dir].tuple.mtu = out->mtu;
+
+	xmit.ifidx = in->ifindex;
+	ether_addr_copy(xmit.h_source, eth->h_dest);
+	ether_addr_copy(xmit.h_dest, eth->h_source);
+	flow_offload_set_xmit(flow, !dir, &xmit);
+	flow->tuplehash[!dir].tuple.mtu = in->mtu;
+
+	flow_offload_entry(flow)->bridged = true;
+
+	return 0;
+}
+
 static bool nft_flow_offload_skip(struct sk_buff *skb, int family)
 {
 	if (skb_sec_path(skb))
@@ -112,13 +270,22 @@ static void nft_flow_offload_eval(const struct nft_expr *expr,
 		goto out;
 
 	dir = CTINFO2DIR(ctinfo);
-	if (nft_flow_route(pkt, ct, &route, dir) < 0)
+	if (nft_pf(pkt) == NFPROTO_BRIDGE)
+		memset(&route, 0, sizeof(route));
+	else if (nft_flow_route(pkt, ct, &route, dir) < 0)
 		goto err_flow_route;
 
 	flow = flow_offload_alloc(ct, &route);
 	if (!flow)
 		goto err_flow_alloc;
 
+	if (nft_pf(pkt) == NFPROTO_BRIDGE) {
+		if (nft_flow_bridge_xmit(pkt, priv->flowtable, flow, dir) < 0)
+			goto err_flow_add;
+	} else {
+		nft_flow_route_xmit(priv->flowtable, ct, &route, flow);
+	}
+
 	if (tcph) {
 		ct->proto.tcp.seen[0].flags |= IP_CT_TCP_FLAG_BE_LIBERAL;
 		ct->proto.tcp.seen[1].flags |= IP_CT_TCP_FLAG_BE_LIBERAL;
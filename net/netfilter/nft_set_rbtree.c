@@ -10,18 +10,53 @@
 #include <linux/module.h>
 #include <linux/list.h>
 #include <linux/rbtree.h>
+#include <linux/bitops.h>
+#include <linux/mm.h>
 #include <linux/netlink.h>
 #include <linux/netfilter.h>
 #include <linux/netfilter/nf_tables.h>
 #include <net/netfilter/nf_tables_core.h>
 
+/* Packed lookup index for interval sets.
+ *
+ * Walking the tree costs a cache miss per level. The index holds the
+ * keys of all elements active in the generation it was built for, in
+ * tree order (descending, interval starts before ends of the same key)
+ * and laid out as an implicit binary tree (BFS order, children of k at
+ * 2k and 2k + 1) so that the top levels share a few cache lines.
+ *
+ * Any change to the set bumps index_seq and schedules a rebuild, lookups
+ * fall back to the tree until then. A commit that leaves this set alone
+ * still moves the generation on, the first lookup to notice asks for a
+ * rebuild then. NFT_RBTREE_INDEX_PENDING is held until the rebuild is
+ * done so the packet path queues at most one.
+ */
+struct nft_rbtree_index {
+	struct rcu_head			rcu;
+	unsigned int			seq;
+	u8				genmask;
+	unsigned int			num;
+	/* 1-based, slot 0 unused */
+	const struct nft_set_ext	**ext;
+	u8				*keys;
+};
+
 struct nft_rbtree {
 	struct rb_root		root;
 	rwlock_t		lock;
 	seqcount_t		count;
 	struct delayed_work	gc_work;
+	struct nft_rbtree_index __rcu *index;
+	atomic_t		index_seq;
+	unsigned long		index_flags;
+	struct delayed_work	index_work;
 };
 
+#define NFT_RBTREE_INDEX_PENDING	0
+
+/* coalesce rebuilds while a transaction updates many elements */
+#define NFT_RBTREE_INDEX_DELAY	(HZ / 10)
+
 struct nft_rbtree_elem {
 	struct rb_node		node;
 	struct nft_set_ext	ext;
@@ -107,13 +142,61 @@ static bool __nft_rbtree_lookup(const struct net *net, const struct nft_set *set
 	return false;
 }
 
+static const u8 *nft_rbtree_index_key(const struct nft_set *set,
+				      const struct nft_rbtree_index *idx,
+				      unsigned int k)
+{
+	return idx->keys + k * set->klen;
+}
+
+static bool nft_rbtree_index_lookup(const struct nft_set *set,
+				    const struct nft_rbtree_index *idx,
+				    const u32 *key,
+				    const struct nft_set_ext **ext)
+{
+	const struct nft_set_ext *this;
+	unsigned int k = 1;
+
+	/* first key in tree order that is not greater than @key */
+	while (k <= idx->num)
+		k = 2 * k +
+		    (memcmp(nft_rbtree_index_key(set, idx, k), key, set->klen) > 0);
+	k >>= ffs(~k);
+	if (!k)
+		return false;
+
+	this = idx->ext[k];
+	if (nft_set_ext_exists(this, NFT_SET_EXT_FLAGS) &&
+	    (*nft_set_ext_flags(this) & NFT_SET_ELEM_INTERVAL_END))
+		return false;
+	if (nft_set_elem_expired(this))
+		return false;
+
+	*ext = this;
+	return true;
+}
+
 static bool nft_rbtree_lookup(const struct net *net, const struct nft_set *set,
 			      const u32 *key, const struct nft_set_ext **ext)
 {
 	struct nft_rbtree *priv = nft_set_priv(set);
-	unsigned int seq = read_seqcount_begin(&priv->count);
+	const struct nft_rbtree_index *idx;
+	unsigned int seq;
 	bool ret;
 
+	idx = rcu_dereference(priv->index);
+	if (idx && idx->seq == atomic_read(&priv->index_seq) &&
+	    idx->genmask == nft_genmask_cur(net))
+		return nft_rbtree_index_lookup(set, idx, key, ext);
+
+	/* index missing or stale, rebuild it and walk the tree meanwhile */
+	if (set->flags & NFT_SET_INTERVAL &&
+	    !test_bit(NFT_RBTREE_INDEX_PENDING, &priv->index_flags) &&
+	    !test_and_set_bit(NFT_RBTREE_INDEX_PENDING, &priv->index_flags))
+		queue_delayed_work(system_power_efficient_wq,
+				   &priv->index_work, NFT_RBTREE_INDEX_DELAY);
+
+	seq = read_seqcount_begin(&priv->count);
 	ret = __nft_rbtree_lookup(net, set, key, ext, seq);
 	if (ret || !read_seqcount_retry(&priv->count, seq))
 		return ret;
@@ -214,6 +297,119 @@ static void *nft_rbtree_get(const struct net *net, const struct nft_set *set,
 	return rbe;
 }
 
+static void nft_rbtree_index_invalidate(const struct nft_set *set)
+{
+	struct nft_rbtree *priv = nft_set_priv(set);
+
+	if (!(set->flags & NFT_SET_INTERVAL))
+		return;
+
+	/* Order element updates before the index becomes stale and the
+	 * index going stale before elements are erased and freed.
+	 */
+	smp_mb__before_atomic();
+	atomic_inc(&priv->index_seq);
+	smp_mb__after_atomic();
+	set_bit(NFT_RBTREE_INDEX_PENDING, &priv->index_flags);
+	mod_delayed_work(system_power_efficient_wq, &priv->index_work,
+			 NFT_RBTREE_INDEX_DELAY);
+}
+
+static void nft_rbtree_index_free_rcu(struct rcu_head *head)
+{
+	kvfree(container_of(head, struct nft_rbtree_index, rcu));
+}
+
+/* In-order walk of the implicit tree, see struct nft_rbtree_index */
+static unsigned int nft_rbtree_index_first(unsigned int k, unsigned int num)
+{
+	while (2 * k <= num)
+		k *= 2;
+	return k;
+}
+
+static unsigned int nft_rbtree_index_next(unsigned int k, unsigned int num)
+{
+	if (2 * k + 1 <= num)
+		return nft_rbtree_index_first(2 * k + 1, num);
+
+	while (k & 1)
+		k >>= 1;
+	return k >> 1;
+}
+
+static void nft_rbtree_index_build(struct work_struct *work)
+{
+	struct nft_rbtree_index *idx, *old;
+	unsigned int i, k, num, seq, size;
+	struct nft_rbtree_elem *rbe;
+	struct nft_rbtree *priv;
+	struct rb_node *node;
+	struct nft_set *set;
+	struct net *net;
+	u8 genmask;
+
+	priv = container_of(work, struct nft_rbtree, index_work.work);
+	set  = nft_set_container_of(priv);
+	net  = read_pnet(&set->net);
+
+	num = atomic_read(&set->nelems);
+retry:
+	size = sizeof(*idx) + (num + 1) * (sizeof(*idx->ext) + set->klen);
+	idx = kvzalloc(size, GFP_KERNEL);
+	if (!idx)
+		goto out;
+
+	idx->ext  = (const struct nft_set_ext **)(idx + 1);
+	idx->keys = (u8 *)(idx->ext + num + 1);
+
+	seq = atomic_read(&priv->index_seq);
+	smp_rmb();
+	genmask = nft_genmask_cur(net);
+
+	read_lock_bh(&priv->lock);
+	for (node = rb_first(&priv->root), i = 0; node; node = rb_next(node)) {
+		rbe = rb_entry(node, struct nft_rbtree_elem, node);
+		if (nft_set_elem_active(&rbe->ext, genmask))
+			i++;
+	}
+	if (i > num) {
+		read_unlock_bh(&priv->lock);
+		kvfree(idx);
+		num = i;
+		goto retry;
+	}
+
+	idx->num = i;
+	k = nft_rbtree_index_first(1, idx->num);
+	for (node = rb_first(&priv->root); node; node = rb_next(node)) {
+		rbe = rb_entry(node, struct nft_rbtree_elem, node);
+		if (!nft_set_elem_active(&rbe->ext, genmask))
+			continue;
+
+		idx->ext[k] = &rbe->ext;
+		memcpy(idx->keys + k * set->klen, nft_set_ext_key(&rbe->ext),
+		       set->klen);
+		k = nft_rbtree_index_next(k, idx->num);
+	}
+	read_unlock_bh(&priv->lock);
+
+	/* A generation change while walking leaves a mixed snapshot */
+	if (genmask != nft_genmask_cur(net)) {
+		kvfree(idx);
+		goto out;
+	}
+
+	idx->seq = seq;
+	idx->genmask = genmask;
+
+	old = rcu_replace_pointer(priv->index, idx, true);
+	if (old)
+		call_rcu(&old->rcu, nft_rbtree_index_free_rcu);
+out:
+	clear_bit(NFT_RBTREE_INDEX_PENDING, &priv->index_flags);
+}
+
 static int __nft_rbtree_insert(const struct net *net, const struct nft_set *set,
 			       struct nft_rbtree_elem *new,
 			       struct nft_set_ext **ext)
@@ -270,6 +466,9 @@ static int nft_rbtree_insert(const struct net *net, const struct nft_set *set,
 	write_seqcount_end(&priv->count);
 	write_unlock_bh(&priv->lock);
 
+	if (!err)
+		nft_rbtree_index_invalidate(set);
+
 	return err;
 }
 
@@ -282,6 +481,7 @@ static void nft_rbtree_remove(const struct net *net,
 
 	write_lock_bh(&priv->lock);
 	write_seqcount_begin(&priv->count);
+	nft_rbtree_index_invalidate(set);
 	rb_erase(&rbe->node, &priv->root);
 	write_seqcount_end(&priv->count);
 	write_unlock_bh(&priv->lock);
@@ -295,6 +495,7 @@ static void nft_rbtree_activate(const struct net *net,
 
 	nft_set_elem_change_active(net, set, &rbe->ext);
 	nft_set_elem_clear_busy(&rbe->ext);
+	nft_rbtree_index_invalidate(set);
 }
 
 static bool nft_rbtree_flush(const struct net *net,
@@ -305,6 +506,7 @@ static bool nft_rbtree_flush(const struct net *net,
 	if (!nft_set_elem_mark_busy(&rbe->ext) ||
 	    !nft_is_active(net, &rbe->ext)) {
 		nft_set_elem_change_active(net, set, &rbe->ext);
+		nft_rbtree_index_invalidate(set);
 		return true;
 	}
 	return false;
@@ -386,6 +588,7 @@ static void nft_rbtree_gc(struct work_struct *work)
 {
 	struct nft_rbtree_elem *rbe, *rbe_end = NULL, *rbe_prev = NULL;
 	struct nft_set_gc_batch *gcb = NULL;
+	bool invalidated = false;
 	struct nft_rbtree *priv;
 	struct rb_node *node;
 	struct nft_set *set;
@@ -407,6 +610,14 @@ static void nft_rbtree_gc(struct work_struct *work)
 		if (nft_set_elem_mark_busy(&rbe->ext))
 			continue;
 
+		/* Full batches are freed from within this loop, stop the index
+		 * from handing out their elements before the first one goes.
+		 */
+		if (!invalidated) {
+			nft_rbtree_index_invalidate(set);
+			invalidated = true;
+		}
+
 		if (rbe_prev) {
 			rb_erase(&rbe_prev->node, &priv->root);
 			rbe_prev = NULL;
@@ -457,6 +668,10 @@ static int nft_rbtree_init(const struct nft_set *set,
 	priv->root = RB_ROOT;
 
 	INIT_DEFERRABLE_WORK(&priv->gc_work, nft_rbtree_gc);
+	INIT_DELAYED_WORK(&priv->index_work, nft_rbtree_index_build);
+	RCU_INIT_POINTER(priv->index, NULL);
+	atomic_set(&priv->index_seq, 0);
+	priv->index_flags = 0;
 	if (set->flags & NFT_SET_TIMEOUT)
 		queue_delayed_work(system_power_efficient_wq, &priv->gc_work,
 				   nft_set_gc_interval(set));
@@ -471,7 +686,9 @@ static void nft_rbtree_destroy(const struct nft_set *set)
 	struct rb_node *node;
 
 	cancel_delayed_work_sync(&priv->gc_work);
+	cancel_delayed_work_sync(&priv->index_work);
 	rcu_barrier();
+	kvfree(rcu_dereference_protected(priv->index, true));
 	while ((node = priv->root.rb_node) != NULL) {
 		rb_erase(node, &priv->root);
 		rbe = rb_entry(node, struct nft_rbtree_elem, node);
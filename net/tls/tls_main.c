@@ -273,6 +273,10 @@ static void tls_sk_proto_cleanup(struct sock *sk,
 	    !wait_on_pending_writer(sk, &timeo))
 		tls_handle_open_record(sk, 0);
 
+	/* Data held back for TLS_TX_COALESCE was not sent with MSG_MORE */
+	if (ctx->tx_conf == TLS_SW && tls_sw_ctx_tx(ctx)->open_rec_held)
+		tls_handle_open_record(sk, MSG_DONTWAIT);
+
 	/* We need these for tls_sw_fallback handling of other packets */
 	if (ctx->tx_conf == TLS_SW) {
 		kfree(ctx->tx.rec_seq);
@@ -416,6 +420,62 @@ static int do_tls_getsockopt_tx(struct sock *sk, char __user *optval,
 	return rc;
 }
 
+static int do_tls_getsockopt_sw_tx(struct sock *sk, int optname,
+				   char __user *optval, int __user *optlen)
+{
+	struct tls_context *ctx = tls_get_ctx(sk);
+	struct tls_sw_context_tx *sw_ctx;
+	unsigned int value = 0;
+	int len;
+
+	if (get_user(len, optlen))
+		return -EFAULT;
+
+	if (len < sizeof(value))
+		return -EINVAL;
+
+	lock_sock(sk);
+	if (ctx->tx_conf == TLS_SW) {
+		sw_ctx = tls_sw_ctx_tx(ctx);
+		if (optname == TLS_TX_ASYNC)
+			value = sw_ctx->crypto_offload;
+		else
+			value = sw_ctx->coalesce_us;
+	}
+	release_sock(sk);
+
+	if (put_user(sizeof(value), optlen) ||
+	    copy_to_user(optval, &value, sizeof(value)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static int do_tls_getsockopt_no_pad(struct sock *sk, char __user *optval,
+				    int __user *optlen)
+{
+	struct tls_context *ctx = tls_get_ctx(sk);
+	unsigned int value = 0;
+	int len;
+
+	if (get_user(len, optlen))
+		return -EFAULT;
+
+	if (len < sizeof(value))
+		return -EINVAL;
+
+	lock_sock(sk);
+	if (ctx->rx_conf == TLS_SW)
+		value = ctx->rx_no_pad;
+	release_sock(sk);
+
+	if (put_user(sizeof(value), optlen) ||
+	    copy_to_user(optval, &value, sizeof(value)))
+		return -EFAULT;
+
+	return 0;
+}
+
 static int do_tls_getsockopt(struct sock *sk, int optname,
 			     char __user *optval, int __user *optlen)
 {
@@ -425,6 +485,13 @@ static int do_tls_getsockopt(struct sock *sk, int optname,
 	case TLS_TX:
 		rc = do_tls_getsockopt_tx(sk, optval, optlen);
 		break;
+	case TLS_TX_ASYNC:
+	case TLS_TX_COALESCE:
+		rc = do_tls_getsockopt_sw_tx(sk, optname, optval, optlen);
+		break;
+	case TLS_RX_EXPECT_NO_PAD:
+		rc = do_tls_getsockopt_no_pad(sk, optval, optlen);
+		break;
 	default:
 		rc = -ENOPROTOOPT;
 		break;
@@ -563,6 +630,79 @@ static int do_tls_setsockopt_conf(struct sock *sk, char __user *optval,
 	return rc;
 }
 
+static int do_tls_setsockopt_sw_tx(struct sock *sk, int optname,
+				   char __user *optval, unsigned int optlen)
+{
+	struct tls_context *ctx = tls_get_ctx(sk);
+	struct tls_sw_context_tx *sw_ctx;
+	unsigned int value;
+	int rc = 0;
+
+	if (!optval || optlen < sizeof(value))
+		return -EINVAL;
+
+	if (get_user(value, (unsigned int __user *)optval))
+		return -EFAULT;
+
+	if (optname == TLS_TX_COALESCE && value > USEC_PER_SEC)
+		return -EINVAL;
+
+	mutex_lock(&ctx->tx_lock);
+	lock_sock(sk);
+
+	/* Only meaningful once TLS_TX set up software crypto */
+	if (ctx->tx_conf != TLS_SW) {
+		rc = -EINVAL;
+		goto out;
+	}
+
+	sw_ctx = tls_sw_ctx_tx(ctx);
+	if (optname == TLS_TX_ASYNC) {
+		sw_ctx->crypto_offload = !!value;
+		/* Records must not point to user pages once encryption
+		 * may outlive the sendmsg() call.
+		 */
+		if (value)
+			sw_ctx->async_capable = 1;
+	} else {
+		sw_ctx->coalesce_us = value;
+		if (!value && sw_ctx->open_rec_held)
+			rc = tls_handle_open_record(sk, MSG_DONTWAIT);
+	}
+out:
+	release_sock(sk);
+	mutex_unlock(&ctx->tx_lock);
+	return rc;
+}
+
+static int do_tls_setsockopt_no_pad(struct sock *sk, char __user *optval,
+				    unsigned int optlen)
+{
+	struct tls_context *ctx = tls_get_ctx(sk);
+	unsigned int value;
+	int rc = 0;
+
+	if (!optval || optlen < sizeof(value))
+		return -EINVAL;
+
+	if (get_user(value, (unsigned int __user *)optval))
+		return -EFAULT;
+
+	if (value > 1)
+		return -EINVAL;
+
+	lock_sock(sk);
+	/* Only TLS 1.3 hides the record type and padding in the payload */
+	if (ctx->rx_conf != TLS_SW ||
+	    ctx->prot_info.version != TLS_1_3_VERSION)
+		rc = -EINVAL;
+	else
+		ctx->rx_no_pad = value;
+	release_sock(sk);
+
+	return rc;
+}
+
 static int do_tls_setsockopt(struct sock *sk, int optname,
 			     char __user *optval, unsigned int optlen)
 {
@@ -576,6 +716,13 @@ static int do_tls_setsockopt(struct sock *sk, int optname,
 					    optname == TLS_TX);
 		release_sock(sk);
 		break;
+	case TLS_TX_ASYNC:
+	case TLS_TX_COALESCE:
+		rc = do_tls_setsockopt_sw_tx(sk, optname, optval, optlen);
+		break;
+	case TLS_RX_EXPECT_NO_PAD:
+		rc = do_tls_setsockopt_no_pad(sk, optval, optlen);
+		break;
 	default:
 		rc = -ENOPROTOOPT;
 		break;
@@ -850,6 +997,32 @@ static int tls_get_info(const struct sock *sk, struct sk_buff *skb)
 	if (err)
 		goto nla_failure;
 
+	if (ctx->tx_conf == TLS_SW) {
+		err = nla_put_u64_64bit(skb, TLS_INFO_TX_RECORDS,
+					READ_ONCE(ctx->tx_records),
+					TLS_INFO_UNSPEC);
+		if (err)
+			goto nla_failure;
+
+		err = nla_put_u64_64bit(skb, TLS_INFO_TX_ASYNC_RECORDS,
+					READ_ONCE(ctx->tx_async_records),
+					TLS_INFO_UNSPEC);
+		if (err)
+			goto nla_failure;
+
+		err = nla_put_u64_64bit(skb, TLS_INFO_TX_COALESCED,
+					READ_ONCE(ctx->tx_coalesced),
+					TLS_INFO_UNSPEC);
+		if (err)
+			goto nla_failure;
+	}
+
+	if (ctx->rx_conf == TLS_SW && ctx->rx_no_pad) {
+		err = nla_put_flag(skb, TLS_INFO_RX_NO_PAD);
+		if (err)
+			goto nla_failure;
+	}
+
 	rcu_read_unlock();
 	nla_nest_end(skb, start);
 	return 0;
@@ -869,6 +1042,10 @@ static size_t tls_get_info_size(const struct sock *sk)
 		nla_total_size(sizeof(u16)) +	/* TLS_INFO_CIPHER */
 		nla_total_size(sizeof(u16)) +	/* TLS_INFO_RXCONF */
 		nla_total_size(sizeof(u16)) +	/* TLS_INFO_TXCONF */
+		nla_total_size_64bit(sizeof(u64)) + /* TLS_INFO_TX_RECORDS */
+		nla_total_size_64bit(sizeof(u64)) + /* TLS_INFO_TX_ASYNC_RECORDS */
+		nla_total_size_64bit(sizeof(u64)) + /* TLS_INFO_TX_COALESCED */
+		nla_total_size(0) +		/* TLS_INFO_RX_NO_PAD */
 		0;
 
 	return size;
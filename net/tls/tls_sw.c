@@ -433,6 +433,10 @@ static void tls_encrypt_done(struct crypto_async_request *req, int err)
 	bool ready = false;
 	int pending;
 
+	/* A backlogged request was started, completion follows */
+	if (err == -EINPROGRESS)
+		return;
+
 	rec = container_of(aead_req, struct tls_rec, aead_req);
 	msg_en = &rec->msg_encrypted;
 
@@ -462,7 +466,11 @@ static void tls_encrypt_done(struct crypto_async_request *req, int err)
 		/* If received record is at head of tx_list, schedule tx */
 		first_rec = list_first_entry(&ctx->tx_list,
 					     struct tls_rec, list);
-		if (rec == first_rec)
+		/* Offloaded records complete out of order on different
+		 * CPUs, always kick the tx work so that a record finishing
+		 * while tls_tx_records() runs is not left behind.
+		 */
+		if (rec == first_rec || ctx->crypto_offload)
 			ready = true;
 	}
 
@@ -478,7 +486,20 @@ static void tls_encrypt_done(struct crypto_async_request *req, int err)
 
 	/* Schedule the transmission */
 	if (!test_and_set_bit(BIT_TX_SCHEDULED, &ctx->tx_bitmask))
-		schedule_delayed_work(&ctx->tx_work.work, 1);
+		schedule_delayed_work(&ctx->tx_work.work,
+				      ctx->crypto_offload ? 0 : 1);
+}
+
+static void tls_encrypt_work(struct work_struct *work)
+{
+	struct tls_rec *rec = container_of(work, struct tls_rec, encrypt_work);
+	int rc;
+
+	rc = crypto_aead_encrypt(&rec->aead_req);
+	if (rc == -EINPROGRESS || rc == -EBUSY)
+		return;
+
+	tls_encrypt_done(&rec->aead_req.base, rc);
 }
 
 static int tls_do_encryption(struct sock *sk,
@@ -522,7 +543,14 @@ static int tls_do_encryption(struct sock *sk,
 	list_add_tail((struct list_head *)&rec->list, &ctx->tx_list);
 	atomic_inc(&ctx->encrypt_pending);
 
-	rc = crypto_aead_encrypt(aead_req);
+	if (ctx->crypto_offload) {
+		/* tls_encrypt_done() runs from the worker */
+		INIT_WORK(&rec->encrypt_work, tls_encrypt_work);
+		queue_work(system_unbound_wq, &rec->encrypt_work);
+		rc = -EINPROGRESS;
+	} else {
+		rc = crypto_aead_encrypt(aead_req);
+	}
 	if (!rc || rc != -EINPROGRESS) {
 		atomic_dec(&ctx->encrypt_pending);
 		sge->offset -= prot->prepend_size;
@@ -538,7 +566,12 @@ static int tls_do_encryption(struct sock *sk,
 
 	/* Unhook the record from context if encryption is not failure */
 	ctx->open_rec = NULL;
+	ctx->open_rec_held = false;
 	tls_advance_record_sn(sk, prot, &tls_ctx->tx);
+
+	tls_ctx->tx_records++;
+	if (rc == -EINPROGRESS)
+		tls_ctx->tx_async_records++;
 	return rc;
 }
 
@@ -909,6 +942,28 @@ static int tls_sw_push_pending_record(struct sock *sk, int flags)
 				   &copied, flags);
 }
 
+/* Push the held open record once its deadline passed, otherwise make
+ * sure the tx work looks at it again by then.
+ */
+static void tls_sw_tx_coalesce(struct sock *sk, int flags)
+{
+	struct tls_context *tls_ctx = tls_get_ctx(sk);
+	struct tls_sw_context_tx *ctx = tls_sw_ctx_tx(tls_ctx);
+	long delay;
+
+	if (!ctx->open_rec_held)
+		return;
+
+	delay = (long)(ctx->coalesce_deadline - jiffies);
+	if (delay <= 0) {
+		tls_sw_push_pending_record(sk, flags);
+		return;
+	}
+
+	if (!test_and_set_bit(BIT_TX_SCHEDULED, &ctx->tx_bitmask))
+		schedule_delayed_work(&ctx->tx_work.work, delay);
+}
+
 int tls_sw_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
 {
 	long timeo = sock_sndtimeo(sk, msg->msg_flags & MSG_DONTWAIT);
@@ -927,6 +982,7 @@ int tls_sw_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
 	int num_async = 0;
 	bool full_record;
 	int record_room;
+	bool coalesce = false;
 	int num_zc = 0;
 	int orig_size;
 	int ret = 0;
@@ -938,6 +994,15 @@ int tls_sw_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
 	mutex_lock(&tls_ctx->tx_lock);
 	lock_sock(sk);
 
+	/* Treat the write as MSG_MORE and let the partial record wait up
+	 * to coalesce_us for more data, see tls_sw_tx_coalesce(). Control
+	 * records go out right away.
+	 */
+	if (eor && ctx->coalesce_us && !msg->msg_controllen) {
+		eor = false;
+		coalesce = true;
+	}
+
 	if (unlikely(msg->msg_controllen)) {
 		ret = tls_proccess_cmsg(sk, msg, &record_type);
 		if (ret) {
@@ -1125,6 +1190,17 @@ int tls_sw_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
 	}
 
 send_end:
+	if (coalesce && ctx->open_rec &&
+	    ctx->open_rec->msg_plaintext.sg.size) {
+		if (!ctx->open_rec_held) {
+			ctx->open_rec_held = true;
+			ctx->coalesce_deadline = jiffies +
+				usecs_to_jiffies(ctx->coalesce_us);
+		}
+		tls_ctx->tx_coalesced++;
+		tls_sw_tx_coalesce(sk, msg->msg_flags);
+	}
+
 	ret = sk_stream_error(sk, msg->msg_flags, ret);
 
 	release_sock(sk);
@@ -1407,8 +1483,10 @@ static int decrypt_internal(struct sock *sk, struct sk_buff *skb,
 	int iv_offset = 0;
 
 	if (*zc && (out_iov || out_sg)) {
+		/* TLS 1.3 content type goes to ctx->tail, not to the user */
 		if (out_iov)
-			n_sgout = iov_iter_npages(out_iov, INT_MAX) + 1;
+			n_sgout = iov_iter_npages(out_iov, INT_MAX) + 1 +
+				  prot->tail_size;
 		else
 			n_sgout = sg_nents(out_sg);
 		n_sgin = skb_nsg(skb, rxm->offset + prot->prepend_size,
@@ -1492,11 +1570,19 @@ static int decrypt_internal(struct sock *sk, struct sk_buff *skb,
 			sg_set_buf(&sgout[0], aad, prot->aad_size);
 
 			*chunk = 0;
-			err = tls_setup_from_iter(sk, out_iov, data_len,
+			err = tls_setup_from_iter(sk, out_iov,
+						  data_len - prot->tail_size,
 						  &pages, chunk, &sgout[1],
-						  (n_sgout - 1));
+						  (n_sgout - 1 - prot->tail_size));
 			if (err < 0)
 				goto fallback_to_reg_recv;
+
+			if (prot->tail_size) {
+				sg_unmark_end(&sgout[pages]);
+				sg_set_buf(&sgout[pages + 1], &ctx->tail,
+					   prot->tail_size);
+				sg_mark_end(&sgout[pages + 1]);
+			}
 		} else if (out_sg) {
 			memcpy(sgout, out_sg, n_sgout * sizeof(*sgout));
 		} else {
@@ -1552,13 +1638,33 @@ static int decrypt_skb_update(struct sock *sk, struct sk_buff *skb,
 
 				return err;
 			}
+
+			/* The peer padded the record or it is not data after
+			 * all. The skb is untouched by an out-of-place
+			 * decryption, so take it back from the user and
+			 * decrypt in place.
+			 */
+			if (*zc && prot->tail_size &&
+			    ctx->tail != TLS_RECORD_TYPE_DATA) {
+				iov_iter_revert(dest, *chunk);
+				*zc = false;
+				err = decrypt_internal(sk, skb, NULL, NULL,
+						       chunk, zc, false);
+				if (err < 0)
+					return err;
+			}
 		} else {
 			*zc = false;
 		}
 
-		pad = padding_length(ctx, prot, skb);
-		if (pad < 0)
-			return pad;
+		if (*zc && prot->tail_size) {
+			ctx->control = ctx->tail;
+			pad = 0;
+		} else {
+			pad = padding_length(ctx, prot, skb);
+			if (pad < 0)
+				return pad;
+		}
 
 		rxm->full_len -= pad;
 		rxm->offset += prot->prepend_size;
@@ -1802,7 +1908,8 @@ int tls_sw_recvmsg(struct sock *sk,
 
 		if (to_decrypt <= len && !is_kvec && !is_peek &&
 		    ctx->control == TLS_RECORD_TYPE_DATA &&
-		    prot->version != TLS_1_3_VERSION &&
+		    (prot->version != TLS_1_3_VERSION ||
+		     tls_ctx->rx_no_pad) &&
 		    !bpf_strp_enabled)
 			zc = true;
 
@@ -2250,6 +2357,7 @@ static void tx_work_handler(struct work_struct *work)
 	mutex_lock(&tls_ctx->tx_lock);
 	lock_sock(sk);
 	tls_tx_records(sk, -1);
+	tls_sw_tx_coalesce(sk, MSG_DONTWAIT);
 	release_sock(sk);
 	mutex_unlock(&tls_ctx->tx_lock);
 }
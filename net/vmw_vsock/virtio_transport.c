@@ -25,6 +25,17 @@ static struct workqueue_struct *virtio_vsock_workqueue;
 static struct virtio_vsock __rcu *the_virtio_vsock;
 static DEFINE_MUTEX(the_virtio_vsock_mutex); /* protects the_virtio_vsock */
 
+/* Larger receive buffers let the device place up to a whole 64KB packet
+ * in one buffer instead of splitting it into 4KB ones, at the cost of
+ * more memory pinned in the RX virtqueue.
+ */
+static unsigned int rx_buf_size = VIRTIO_VSOCK_DEFAULT_RX_BUF_SIZE;
+module_param(rx_buf_size, uint, 0444);
+MODULE_PARM_DESC(rx_buf_size, "Size of RX buffers in bytes (4096-65536)");
+
+/* Max packets handed to the core at once from the RX virtqueue */
+#define VIRTIO_VSOCK_RX_BATCH	16
+
 struct virtio_vsock {
 	struct virtio_device *vdev;
 	struct virtqueue *vqs[VSOCK_VQ_MAX];
@@ -248,7 +259,9 @@ virtio_transport_cancel_pkt(struct vsock_sock *vsk)
 
 static void virtio_vsock_rx_fill(struct virtio_vsock *vsock)
 {
-	int buf_len = VIRTIO_VSOCK_DEFAULT_RX_BUF_SIZE;
+	int buf_len = clamp_t(unsigned int, rx_buf_size,
+			      VIRTIO_VSOCK_DEFAULT_RX_BUF_SIZE,
+			      VIRTIO_VSOCK_MAX_PKT_BUF_SIZE);
 	struct virtio_vsock_pkt *pkt;
 	struct scatterlist hdr, buf, *sgs[2];
 	struct virtqueue *vq;
@@ -494,6 +507,8 @@ static void virtio_transport_rx_work(struct work_struct *work)
 	struct virtio_vsock *vsock =
 		container_of(work, struct virtio_vsock, rx_work);
 	struct virtqueue *vq;
+	LIST_HEAD(pkts);
+	int batched = 0;
 
 	vq = vsock->vqs[VSOCK_VQ_RX];
 
@@ -532,11 +547,24 @@ static void virtio_transport_rx_work(struct work_struct *work)
 
 			pkt->len = len - sizeof(pkt->hdr);
 			virtio_transport_deliver_tap_pkt(pkt);
-			virtio_transport_recv_pkt(&virtio_transport, pkt);
+
+			/* Replies are only queued once the batch is
+			 * delivered, so keep it short enough not to
+			 * overrun the reply limit by much.
+			 */
+			list_add_tail(&pkt->list, &pkts);
+			if (++batched == VIRTIO_VSOCK_RX_BATCH) {
+				virtio_transport_recv_pkt_list(&virtio_transport,
+							       &pkts);
+				batched = 0;
+			}
 		}
+		virtio_transport_recv_pkt_list(&virtio_transport, &pkts);
+		batched = 0;
 	} while (!virtqueue_enable_cb(vq));
 
 out:
+	virtio_transport_recv_pkt_list(&virtio_transport, &pkts);
 	if (vsock->rx_buf_nr < vsock->rx_buf_max_nr / 2)
 		virtio_vsock_rx_fill(vsock);
 	mutex_unlock(&vsock->rx_lock);
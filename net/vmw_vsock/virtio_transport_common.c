@@ -286,7 +286,7 @@ virtio_transport_stream_do_dequeue(struct vsock_sock *vsk,
 	struct virtio_vsock_sock *vvs = vsk->trans;
 	struct virtio_vsock_pkt *pkt;
 	size_t bytes, total = 0;
-	u32 free_space;
+	u32 free_space, fwd_cnt_delta;
 	int err = -EFAULT;
 
 	spin_lock_bh(&vvs->rx_lock);
@@ -318,19 +318,31 @@ virtio_transport_stream_do_dequeue(struct vsock_sock *vsk,
 		}
 	}
 
-	free_space = vvs->buf_alloc - (vvs->fwd_cnt - vvs->last_fwd_cnt);
+	fwd_cnt_delta = vvs->fwd_cnt - vvs->last_fwd_cnt;
+	free_space = vvs->buf_alloc - fwd_cnt_delta;
 
 	spin_unlock_bh(&vvs->rx_lock);
 
-	/* To reduce the number of credit update messages,
-	 * don't update credits as long as lots of space is available.
-	 * Note: the limit chosen here is arbitrary. Setting the limit
-	 * too high causes extra messages. Too low causes transmitter
-	 * stalls. As stalls are in theory more expensive than extra
-	 * messages, we set the limit to a high value. TODO: experiment
-	 * with different values.
+	/* To reduce the number of credit update messages, only announce
+	 * the consumed bytes once the space the peer doesn't know about
+	 * yet is a sizeable part of our buffer: less than a max sized
+	 * packet, or less than a quarter of buf_alloc for buffers smaller
+	 * than a few packets, is left from its point of view. Setting the
+	 * limit too high causes transmitter stalls, too low causes extra
+	 * messages.
+	 *
+	 * A reader waiting for SO_RCVLOWAT bytes could otherwise block
+	 * forever on a peer that ran out of credit, so update as soon as
+	 * the peer can't send enough to wake it up.
+	 *
+	 * Nothing was consumed since the peer last heard about our
+	 * fwd_cnt (e.g. it was piggybacked on a data packet), so there
+	 * is no new credit to announce.
 	 */
-	if (free_space < VIRTIO_VSOCK_MAX_PKT_BUF_SIZE) {
+	if (fwd_cnt_delta &&
+	    (free_space < min_t(u32, VIRTIO_VSOCK_MAX_PKT_BUF_SIZE,
+				vvs->buf_alloc / 4) ||
+	     free_space < READ_ONCE(sk_vsock(vsk)->sk_rcvlowat))) {
 		virtio_transport_send_credit_update(vsk,
 						    VIRTIO_VSOCK_TYPE_STREAM,
 						    NULL);
@@ -1031,6 +1043,30 @@ virtio_transport_recv_listen(struct sock *sk, struct virtio_vsock_pkt *pkt,
 	return 0;
 }
 
+static void virtio_transport_recv_addr(struct virtio_vsock_pkt *pkt,
+				       struct sockaddr_vm *src,
+				       struct sockaddr_vm *dst)
+{
+	vsock_addr_init(src, le64_to_cpu(pkt->hdr.src_cid),
+			le32_to_cpu(pkt->hdr.src_port));
+	vsock_addr_init(dst, le64_to_cpu(pkt->hdr.dst_cid),
+			le32_to_cpu(pkt->hdr.dst_port));
+}
+
+static void virtio_transport_trace_recv(struct virtio_vsock_pkt *pkt,
+					struct sockaddr_vm *src,
+					struct sockaddr_vm *dst)
+{
+	trace_virtio_transport_recv_pkt(src->svm_cid, src->svm_port,
+					dst->svm_cid, dst->svm_port,
+					le32_to_cpu(pkt->hdr.len),
+					le16_to_cpu(pkt->hdr.type),
+					le16_to_cpu(pkt->hdr.op),
+					le32_to_cpu(pkt->hdr.flags),
+					le32_to_cpu(pkt->hdr.buf_alloc),
+					le32_to_cpu(pkt->hdr.fwd_cnt));
+}
+
 /* We are under the virtio-vsock's vsock->rx_lock or vhost-vsock's vq->mutex
  * lock.
  */
@@ -1042,19 +1078,8 @@ void virtio_transport_recv_pkt(struct virtio_transport *t,
 	struct sock *sk;
 	bool space_available;
 
-	vsock_addr_init(&src, le64_to_cpu(pkt->hdr.src_cid),
-			le32_to_cpu(pkt->hdr.src_port));
-	vsock_addr_init(&dst, le64_to_cpu(pkt->hdr.dst_cid),
-			le32_to_cpu(pkt->hdr.dst_port));
-
-	trace_virtio_transport_recv_pkt(src.svm_cid, src.svm_port,
-					dst.svm_cid, dst.svm_port,
-					le32_to_cpu(pkt->hdr.len),
-					le16_to_cpu(pkt->hdr.type),
-					le16_to_cpu(pkt->hdr.op),
-					le32_to_cpu(pkt->hdr.flags),
-					le32_to_cpu(pkt->hdr.buf_alloc),
-					le32_to_cpu(pkt->hdr.fwd_cnt));
+	virtio_transport_recv_addr(pkt, &src, &dst);
+	virtio_transport_trace_recv(pkt, &src, &dst);
 
 	if (le16_to_cpu(pkt->hdr.type) != VIRTIO_VSOCK_TYPE_STREAM) {
 		(void)virtio_transport_reset_no_sock(t, pkt);
@@ -1120,6 +1145,113 @@ void virtio_transport_recv_pkt(struct virtio_transport *t,
 }
 EXPORT_SYMBOL_GPL(virtio_transport_recv_pkt);
 
+/* Connected socket held and locked by virtio_transport_recv_pkt_list() */
+struct virtio_transport_rx_batch {
+	struct sock *sk;
+	struct sockaddr_vm src, dst;
+	bool data_ready;
+	bool write_space;
+};
+
+static void virtio_transport_rx_batch_end(struct virtio_transport_rx_batch *b)
+{
+	struct sock *sk = b->sk;
+
+	if (!sk)
+		return;
+
+	if (b->write_space)
+		sk->sk_write_space(sk);
+	if (b->data_ready)
+		sk->sk_data_ready(sk);
+
+	release_sock(sk);
+	sock_put(sk);
+
+	b->sk = NULL;
+	b->data_ready = false;
+	b->write_space = false;
+}
+
+/* Returns true if @pkt was queued to the socket held in @b */
+static bool virtio_transport_rx_batch_add(struct virtio_transport_rx_batch *b,
+					  struct virtio_vsock_pkt *pkt)
+{
+	struct sockaddr_vm src, dst;
+	struct sock *sk;
+
+	if (le16_to_cpu(pkt->hdr.op) != VIRTIO_VSOCK_OP_RW ||
+	    le16_to_cpu(pkt->hdr.type) != VIRTIO_VSOCK_TYPE_STREAM) {
+		virtio_transport_rx_batch_end(b);
+		return false;
+	}
+
+	virtio_transport_recv_addr(pkt, &src, &dst);
+
+	if (b->sk && (!vsock_addr_equals_addr(&src, &b->src) ||
+		      !vsock_addr_equals_addr(&dst, &b->dst)))
+		virtio_transport_rx_batch_end(b);
+
+	if (!b->sk) {
+		sk = vsock_find_connected_socket(&src, &dst);
+		if (!sk)
+			return false;
+
+		lock_sock(sk);
+		if (sk->sk_state != TCP_ESTABLISHED) {
+			release_sock(sk);
+			sock_put(sk);
+			return false;
+		}
+
+		/* Update CID in case it has changed after a transport
+		 * reset event
+		 */
+		vsock_sk(sk)->local_addr.svm_cid = dst.svm_cid;
+
+		b->sk = sk;
+		b->src = src;
+		b->dst = dst;
+	}
+
+	virtio_transport_trace_recv(pkt, &src, &dst);
+
+	if (virtio_transport_space_update(b->sk, pkt))
+		b->write_space = true;
+
+	virtio_transport_recv_enqueue(vsock_sk(b->sk), pkt);
+	b->data_ready = true;
+	return true;
+}
+
+/* Deliver a list of packets that a transport pulled off its RX queue in
+ * one go.  Runs of data packets for the same connected socket are queued
+ * under a single socket lookup and lock_sock(), and wake up the reader
+ * once per run instead of once per packet.  Everything else goes through
+ * virtio_transport_recv_pkt().
+ *
+ * Same locking rules as virtio_transport_recv_pkt().
+ */
+void virtio_transport_recv_pkt_list(struct virtio_transport *t,
+				    struct list_head *pkts)
+{
+	struct virtio_transport_rx_batch b = {};
+	struct virtio_vsock_pkt *pkt, *n;
+
+	list_for_each_entry_safe(pkt, n, pkts, list) {
+		list_del_init(&pkt->list);
+
+		if (virtio_transport_rx_batch_add(&b, pkt))
+			continue;
+
+		virtio_transport_rx_batch_end(&b);
+		virtio_transport_recv_pkt(t, pkt);
+	}
+
+	virtio_transport_rx_batch_end(&b);
+}
+EXPORT_SYMBOL_GPL(virtio_transport_recv_pkt_list);
+
 void virtio_transport_free_pkt(struct virtio_vsock_pkt *pkt)
 {
 	kfree(pkt->buf);
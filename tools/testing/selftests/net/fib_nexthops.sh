@@ -636,6 +636,20 @@ ipv4_grp_fcnal()
 	check_nexthop "id 103" "id 103 group 12/14,3/15,4"
 	log_test $? 0 "Weighted nexthop group updated when entry is deleted"
 
+	# resilient group, needs iproute2 support for the group type
+	if $IP nexthop help 2>&1 | grep -q resilient; then
+		run_cmd "$IP nexthop add id 13 via 172.16.1.3 dev veth1"
+		run_cmd "$IP nexthop add id 104 group 12/13,2/14 type resilient buckets 8"
+		log_test $? 0 "Resilient nexthop group"
+
+		run_cmd "$IP nexthop del id 13"
+		run_cmd "$IP nexthop get id 104"
+		log_test $? 0 "Resilient nexthop group updated when entry is deleted"
+
+		run_cmd "$IP nexthop add id 105 group 12/14 type resilient buckets 0"
+		log_test $? 2 "Resilient nexthop group with no buckets"
+	fi
+
 	# admin down - nexthop is removed from group
 	run_cmd "$IP li set dev veth1 down"
 	check_nexthop "dev veth1" ""
@@ -245,6 +245,59 @@ TEST_F(tls, msg_more_unsent)
 	EXPECT_EQ(recv(self->cfd, buf, send_len, MSG_DONTWAIT), -1);
 }
 
+TEST_F(tls, tx_coalesce)
+{
+	char const *test_str = "test_read";
+	unsigned int usecs = 200000;
+	int send_len = 10;
+	char buf[10 * 2];
+
+	if (self->notls)
+		return;
+
+	ASSERT_EQ(setsockopt(self->fd, SOL_TLS, TLS_TX_COALESCE, &usecs,
+			     sizeof(usecs)), 0);
+
+	/* Held back like MSG_MORE, then flushed by the latency bound */
+	EXPECT_EQ(send(self->fd, test_str, send_len, 0), send_len);
+	EXPECT_EQ(recv(self->cfd, buf, send_len, MSG_DONTWAIT), -1);
+	EXPECT_EQ(send(self->fd, test_str, send_len, 0), send_len);
+	EXPECT_EQ(recv(self->cfd, buf, send_len * 2, MSG_WAITALL),
+		  send_len * 2);
+	EXPECT_EQ(memcmp(buf, test_str, send_len), 0);
+	EXPECT_EQ(memcmp(buf + send_len, test_str, send_len), 0);
+
+	/* Turning it off flushes what is held */
+	usecs = 0;
+	EXPECT_EQ(send(self->fd, test_str, send_len, 0), send_len);
+	ASSERT_EQ(setsockopt(self->fd, SOL_TLS, TLS_TX_COALESCE, &usecs,
+			     sizeof(usecs)), 0);
+	EXPECT_EQ(recv(self->cfd, buf, send_len, MSG_WAITALL), send_len);
+	EXPECT_EQ(memcmp(buf, test_str, send_len), 0);
+}
+
+TEST_F(tls, tx_async)
+{
+	unsigned int one = 1;
+	char buf[8192];
+	char recv_buf[8192];
+	int i;
+
+	if (self->notls)
+		return;
+
+	ASSERT_EQ(setsockopt(self->fd, SOL_TLS, TLS_TX_ASYNC, &one,
+			     sizeof(one)), 0);
+
+	for (i = 0; i < 64; i++) {
+		memset(buf, i, sizeof(buf));
+		EXPECT_EQ(send(self->fd, buf, sizeof(buf), 0), sizeof(buf));
+		EXPECT_EQ(recv(self->cfd, recv_buf, sizeof(recv_buf),
+			       MSG_WAITALL), sizeof(recv_buf));
+		EXPECT_EQ(memcmp(buf, recv_buf, sizeof(buf)), 0);
+	}
+}
+
 TEST_F(tls, sendmsg_single)
 {
 	struct msghdr msg;
@@ -1093,6 +1146,67 @@ TEST_F(tls, control_msg)
 	EXPECT_EQ(memcmp(buf, test_str, send_len), 0);
 }
 
+TEST_F(tls, rx_no_pad)
+{
+	char cbuf[CMSG_SPACE(sizeof(char))];
+	char const *test_str = "test_read";
+	unsigned int one = 1;
+	char record_type = 100;
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	int send_len = 10;
+	struct iovec vec;
+	char buf[8192];
+	int i;
+
+	if (self->notls)
+		return;
+
+	ASSERT_EQ(setsockopt(self->cfd, SOL_TLS, TLS_RX_EXPECT_NO_PAD, &one,
+			     sizeof(one)), 0);
+
+	/* Data records go straight to the user buffer */
+	for (i = 0; i < 16; i++) {
+		char send_buf[4096];
+
+		memset(send_buf, i, sizeof(send_buf));
+		EXPECT_EQ(send(self->fd, send_buf, sizeof(send_buf), 0),
+			  sizeof(send_buf));
+		EXPECT_EQ(recv(self->cfd, buf, sizeof(buf), 0),
+			  sizeof(send_buf));
+		EXPECT_EQ(memcmp(buf, send_buf, sizeof(send_buf)), 0);
+	}
+
+	/* A non-data record is still delivered with its type */
+	vec.iov_base = (char *)test_str;
+	vec.iov_len = send_len;
+	memset(&msg, 0, sizeof(struct msghdr));
+	msg.msg_iov = &vec;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_TLS;
+	cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(char));
+	*CMSG_DATA(cmsg) = record_type;
+	msg.msg_controllen = cmsg->cmsg_len;
+
+	EXPECT_EQ(sendmsg(self->fd, &msg, 0), send_len);
+
+	record_type = 0;
+	vec.iov_base = buf;
+	vec.iov_len = sizeof(buf);
+	msg.msg_controllen = sizeof(cbuf);
+	EXPECT_EQ(recvmsg(self->cfd, &msg, 0), send_len);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	EXPECT_NE(cmsg, NULL);
+	EXPECT_EQ(cmsg->cmsg_type, TLS_GET_RECORD_TYPE);
+	record_type = *((unsigned char *)CMSG_DATA(cmsg));
+	EXPECT_EQ(record_type, 100);
+	EXPECT_EQ(memcmp(buf, test_str, send_len), 0);
+}
+
 TEST_F(tls, shutdown)
 {
 	char const *test_str = "test_read";
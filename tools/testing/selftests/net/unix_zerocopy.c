@@ -0,0 +1,209 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Exercise MSG_ZEROCOPY on AF_UNIX stream sockets.
+ *
+ * A child process reads from one end of a socketpair while the parent
+ * writes to the other end, with and without MSG_ZEROCOPY.  The payload
+ * is verified on the receive side and, in zerocopy mode, every send
+ * call must be acknowledged on the sender's error queue.
+ *
+ * Usage: unix_zerocopy [-s <send size>] [-t <seconds>]
+ */
+#define _GNU_SOURCE
+
+#include <error.h>
+#include <errno.h>
+#include <time.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY	60
+#endif
+
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY		5
+#endif
+
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY	0x4000000
+#endif
+
+static int cfg_size = 1 << 20;
+static int cfg_runtime_ms = 2000;
+
+static unsigned long gettimeofday_ms(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec * 1000) + (tv.tv_usec / 1000);
+}
+
+static void fill(char *buf, int len, unsigned long off)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = 'a' + ((off + i) % 26);
+}
+
+static void do_rx(int fd)
+{
+	unsigned long off = 0;
+	char *buf;
+	int i, ret;
+
+	buf = malloc(cfg_size);
+	if (!buf)
+		error(1, 0, "malloc");
+
+	while ((ret = read(fd, buf, cfg_size)) > 0) {
+		for (i = 0; i < ret; i++)
+			if (buf[i] != 'a' + ((off + i) % 26))
+				error(1, 0, "rx: bad data at %lu", off + i);
+		off += ret;
+	}
+	if (ret)
+		error(1, errno, "read");
+
+	free(buf);
+	exit(0);
+}
+
+/* Returns the number of send calls acknowledged by this notification */
+static int do_recv_completion(int fd, bool block)
+{
+	struct sock_extended_err *serr;
+	struct msghdr msg = {};
+	struct cmsghdr *cm;
+	char control[100];
+	int ret;
+
+	if (block) {
+		struct pollfd pfd = { .fd = fd, .events = 0 };
+
+		if (poll(&pfd, 1, 1000) != 1 || !(pfd.revents & POLLERR))
+			error(1, 0, "poll: no completion");
+	}
+
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	ret = recvmsg(fd, &msg, MSG_ERRQUEUE);
+	if (ret == -1 && errno == EAGAIN)
+		return 0;
+	if (ret == -1)
+		error(1, errno, "recvmsg errqueue");
+
+	cm = CMSG_FIRSTHDR(&msg);
+	if (!cm || cm->cmsg_level != SOL_IP || cm->cmsg_type != IP_RECVERR)
+		error(1, 0, "unexpected cmsg");
+
+	serr = (void *)CMSG_DATA(cm);
+	if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr->ee_errno)
+		error(1, 0, "unexpected completion origin %u errno %u",
+		      serr->ee_origin, serr->ee_errno);
+
+	return serr->ee_data - serr->ee_info + 1;
+}
+
+static void do_test(bool zerocopy)
+{
+	unsigned long tstop, off = 0, sends = 0, completions = 0;
+	int fds[2], one = 1, ret;
+	pid_t pid;
+	char *buf;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds))
+		error(1, errno, "socketpair");
+
+	pid = fork();
+	if (pid == -1)
+		error(1, errno, "fork");
+	if (!pid) {
+		close(fds[0]);
+		do_rx(fds[1]);
+	}
+	close(fds[1]);
+
+	if (zerocopy &&
+	    setsockopt(fds[0], SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)))
+		error(1, errno, "setsockopt zerocopy");
+
+	buf = malloc(cfg_size);
+	if (!buf)
+		error(1, 0, "malloc");
+
+	tstop = gettimeofday_ms() + cfg_runtime_ms;
+	do {
+		/* The payload must not change until the kernel is done with
+		 * it, so wait for the completion before refilling.
+		 */
+		fill(buf, cfg_size, off);
+		ret = send(fds[0], buf, cfg_size, zerocopy ? MSG_ZEROCOPY : 0);
+		if (ret != cfg_size)
+			error(1, errno, "send: %d", ret);
+		off += ret;
+		sends++;
+
+		while (zerocopy && completions < sends)
+			completions += do_recv_completion(fds[0], true);
+	} while (gettimeofday_ms() < tstop);
+
+	close(fds[0]);
+	if (waitpid(pid, &ret, 0) != pid || !WIFEXITED(ret) ||
+	    WEXITSTATUS(ret))
+		error(1, 0, "receiver failed");
+
+	fprintf(stderr, "%s: %lu MB/s (%lu sends)\n",
+		zerocopy ? "zerocopy" : "copy",
+		(off >> 20) * 1000 / cfg_runtime_ms, sends);
+	free(buf);
+}
+
+static void test_dgram_unsupported(void)
+{
+	int fd, one = 1;
+
+	fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+	if (fd == -1)
+		error(1, errno, "socket");
+	if (!setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)))
+		error(1, 0, "SO_ZEROCOPY accepted on SOCK_DGRAM");
+	close(fd);
+}
+
+int main(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "s:t:")) != -1) {
+		switch (c) {
+		case 's':
+			cfg_size = strtol(optarg, NULL, 0);
+			break;
+		case 't':
+			cfg_runtime_ms = strtol(optarg, NULL, 0) * 1000;
+			break;
+		default:
+			error(1, 0, "usage: %s [-s size] [-t seconds]", argv[0]);
+		}
+	}
+
+	test_dgram_unsupported();
+	do_test(false);
+	do_test(true);
+
+	fprintf(stderr, "OK\n");
+	return 0;
+}
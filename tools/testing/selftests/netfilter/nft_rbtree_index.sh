@@ -0,0 +1,129 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Check that interval set lookups give the right answer while the packed
+# lookup index of the rbtree backend is stale, i.e. right after elements
+# were added, deleted or flushed, and again once it has been rebuilt.
+
+# Kselftest framework requirement - SKIP code is 4.
+ksft_skip=4
+ret=0
+
+sfx=$(mktemp -u "XXXXXXXX")
+ns="ns-$sfx"
+
+nft --version > /dev/null 2>&1
+if [ $? -ne 0 ];then
+	echo "SKIP: Could not run test without nft tool"
+	exit $ksft_skip
+fi
+
+ip -Version > /dev/null 2>&1
+if [ $? -ne 0 ];then
+	echo "SKIP: Could not run test without ip tool"
+	exit $ksft_skip
+fi
+
+ip netns add "$ns"
+if [ $? -ne 0 ];then
+	echo "SKIP: Could not create net namespace $ns"
+	exit $ksft_skip
+fi
+
+trap "ip netns del $ns" EXIT
+
+ip -net "$ns" link set lo up
+
+ip netns exec "$ns" nft -f - <<EOF
+table ip t {
+	set s {
+		type ipv4_addr
+		flags interval
+	}
+
+	chain output {
+		type filter hook output priority 0; policy accept;
+		ip daddr @s counter drop
+	}
+}
+EOF
+if [ $? -ne 0 ]; then
+	echo "SKIP: Could not load interval set ruleset"
+	exit $ksft_skip
+fi
+
+# $1: address, $2: expected verdict (accept or drop), $3: description
+check()
+{
+	local addr=$1
+	local want=$2
+	local got=accept
+
+	ip netns exec "$ns" ping -q -c 1 -W 1 "$addr" > /dev/null 2>&1 || got=drop
+
+	if [ "$got" != "$want" ]; then
+		echo "FAIL: $3: $addr got $got, expected $want"
+		ret=1
+	fi
+}
+
+# run the checks with a stale index and once more after the rebuild
+check_all()
+{
+	local i
+
+	for i in stale rebuilt; do
+		[ $i = rebuilt ] && sleep 0.5
+		"$@" "$i"
+	done
+}
+
+added()
+{
+	check 127.0.1.1   drop   "add ($1)"
+	check 127.0.1.254 drop   "add ($1)"
+	check 127.0.3.1   drop   "add ($1)"
+	check 127.0.2.1   accept "add ($1)"
+	check 127.0.4.1   accept "add ($1)"
+}
+
+deleted()
+{
+	check 127.0.1.1   accept "delete ($1)"
+	check 127.0.3.1   drop   "delete ($1)"
+	check 127.0.2.1   accept "delete ($1)"
+}
+
+flushed()
+{
+	check 127.0.1.1   accept "flush ($1)"
+	check 127.0.3.1   accept "flush ($1)"
+}
+
+readded()
+{
+	check 127.0.2.1   drop   "re-add ($1)"
+	check 127.0.3.1   accept "re-add ($1)"
+}
+
+ip netns exec "$ns" nft add element ip t s '{ 127.0.1.0/24, 127.0.3.0/24 }'
+check_all added
+
+ip netns exec "$ns" nft delete element ip t s '{ 127.0.1.0/24 }'
+check_all deleted
+
+ip netns exec "$ns" nft flush set ip t s
+check_all flushed
+
+ip netns exec "$ns" nft add element ip t s '{ 127.0.2.0/24 }'
+check_all readded
+
+# a commit that doesn't touch the set must not leave it stale either
+ip netns exec "$ns" nft add chain ip t c
+check_all readded
+
+if [ $ret -eq 0 ]; then
+	echo "PASS: interval set lookups with stale and rebuilt index"
+fi
+
+exit $ret
@@ -0,0 +1,415 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * vsock_perf - AF_VSOCK stream throughput benchmark
+ *
+ * By default the sender and the receiver run on this machine and talk
+ * through the loopback transport (VMADDR_CID_LOCAL), so no hypervisor is
+ * needed.  With --mode the two halves can also run on either side of a
+ * host<->guest link.
+ *
+ * --verify turns it into a functional test of the credit flow control:
+ * the payload is checked on the receiver and a read that makes no
+ * progress for TIMEOUT seconds (a transmitter waiting for a credit update
+ * that never comes) fails the run.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "../../../include/uapi/linux/vm_sockets.h"
+#include "timeout.h"
+
+enum perf_mode {
+	PERF_MODE_LOOPBACK,
+	PERF_MODE_CLIENT,
+	PERF_MODE_SERVER
+};
+
+static unsigned int port = 1234;
+static unsigned long long total_bytes = 1ULL << 30;
+static size_t buf_size = 128 * 1024;
+static unsigned long long vsock_buf_size;
+static int rcvlowat;
+static bool verify;
+
+/* Payload byte at stream offset @off, 251 so it doesn't line up with
+ * any power of two buffer or packet size.
+ */
+static unsigned char pattern(unsigned long long off)
+{
+	return off % 251;
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void set_vsock_buf_size(int fd)
+{
+	if (!vsock_buf_size)
+		return;
+
+	if (setsockopt(fd, AF_VSOCK, SO_VM_SOCKETS_BUFFER_MAX_SIZE,
+		       &vsock_buf_size, sizeof(vsock_buf_size)) ||
+	    setsockopt(fd, AF_VSOCK, SO_VM_SOCKETS_BUFFER_SIZE,
+		       &vsock_buf_size, sizeof(vsock_buf_size))) {
+		perror("setsockopt");
+		exit(EXIT_FAILURE);
+	}
+}
+
+static int vsock_listen(void)
+{
+	union {
+		struct sockaddr sa;
+		struct sockaddr_vm svm;
+	} addr = {
+		.svm = {
+			.svm_family = AF_VSOCK,
+			.svm_port = port,
+			.svm_cid = VMADDR_CID_ANY,
+		},
+	};
+	int fd;
+
+	fd = socket(AF_VSOCK, SOCK_STREAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		exit(EXIT_FAILURE);
+	}
+
+	set_vsock_buf_size(fd);
+
+	if (bind(fd, &addr.sa, sizeof(addr.svm)) < 0) {
+		perror("bind");
+		exit(EXIT_FAILURE);
+	}
+
+	if (listen(fd, 1) < 0) {
+		perror("listen");
+		exit(EXIT_FAILURE);
+	}
+
+	return fd;
+}
+
+static void run_receiver(int listen_fd)
+{
+	unsigned long long received = 0;
+	double t0, elapsed;
+	char *buf;
+	ssize_t ret;
+	int fd;
+
+	fd = accept(listen_fd, NULL, NULL);
+	if (fd < 0) {
+		perror("accept");
+		exit(EXIT_FAILURE);
+	}
+	close(listen_fd);
+
+	if (rcvlowat &&
+	    setsockopt(fd, SOL_SOCKET, SO_RCVLOWAT, &rcvlowat,
+		       sizeof(rcvlowat))) {
+		perror("setsockopt(SO_RCVLOWAT)");
+		exit(EXIT_FAILURE);
+	}
+
+	buf = malloc(buf_size);
+	if (!buf) {
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+
+	t0 = now_ns();
+	for (;;) {
+		if (verify)
+			timeout_begin(TIMEOUT);
+		ret = read(fd, buf, buf_size);
+		if (verify) {
+			timeout_check("read");
+			timeout_end();
+		}
+		if (ret <= 0)
+			break;
+
+		if (verify) {
+			ssize_t i;
+
+			for (i = 0; i < ret; i++) {
+				if (buf[i] != (char)pattern(received + i)) {
+					fprintf(stderr, "data mismatch at offset %llu\n",
+						received + i);
+					exit(EXIT_FAILURE);
+				}
+			}
+		}
+		received += ret;
+	}
+	if (ret < 0) {
+		perror("read");
+		exit(EXIT_FAILURE);
+	}
+
+	elapsed = now_ns() - t0;
+	if (verify && received != total_bytes) {
+		fprintf(stderr, "expected %llu bytes, received %llu\n",
+			total_bytes, received);
+		exit(EXIT_FAILURE);
+	}
+	printf("rx: %llu bytes in %.3f s, %.3f Gbit/s\n", received,
+	       elapsed / 1e9, received * 8 / elapsed);
+
+	free(buf);
+	close(fd);
+}
+
+static void run_sender(unsigned int peer_cid)
+{
+	union {
+		struct sockaddr sa;
+		struct sockaddr_vm svm;
+	} addr = {
+		.svm = {
+			.svm_family = AF_VSOCK,
+			.svm_port = port,
+			.svm_cid = peer_cid,
+		},
+	};
+	unsigned long long sent = 0;
+	double t0, elapsed;
+	char *buf;
+	ssize_t ret;
+	int fd, i;
+
+	fd = socket(AF_VSOCK, SOCK_STREAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		exit(EXIT_FAILURE);
+	}
+
+	set_vsock_buf_size(fd);
+
+	/* The receiver may still be setting up its listener */
+	for (i = 0; connect(fd, &addr.sa, sizeof(addr.svm)) < 0; i++) {
+		if ((errno != ECONNRESET && errno != ECONNREFUSED) || i == 50) {
+			perror("connect");
+			exit(EXIT_FAILURE);
+		}
+		usleep(100 * 1000);
+	}
+
+	buf = malloc(buf_size);
+	if (!buf) {
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	memset(buf, 'v', buf_size);
+
+	t0 = now_ns();
+	while (sent < total_bytes) {
+		size_t len = buf_size;
+
+		if (total_bytes - sent < len)
+			len = total_bytes - sent;
+
+		if (verify) {
+			size_t i;
+
+			for (i = 0; i < len; i++)
+				buf[i] = pattern(sent + i);
+		}
+
+		ret = write(fd, buf, len);
+		if (ret < 0) {
+			perror("write");
+			exit(EXIT_FAILURE);
+		}
+		sent += ret;
+	}
+
+	elapsed = now_ns() - t0;
+	printf("tx: %llu bytes in %.3f s, %.3f Gbit/s\n", sent,
+	       elapsed / 1e9, sent * 8 / elapsed);
+
+	free(buf);
+	close(fd);
+}
+
+static const char optstring[] = "";
+static const struct option longopts[] = {
+	{
+		.name = "mode",
+		.has_arg = required_argument,
+		.val = 'm',
+	},
+	{
+		.name = "peer-cid",
+		.has_arg = required_argument,
+		.val = 'p',
+	},
+	{
+		.name = "port",
+		.has_arg = required_argument,
+		.val = 'P',
+	},
+	{
+		.name = "bytes",
+		.has_arg = required_argument,
+		.val = 'b',
+	},
+	{
+		.name = "buf-size",
+		.has_arg = required_argument,
+		.val = 's',
+	},
+	{
+		.name = "vsk-size",
+		.has_arg = required_argument,
+		.val = 'v',
+	},
+	{
+		.name = "rcvlowat",
+		.has_arg = required_argument,
+		.val = 'l',
+	},
+	{
+		.name = "verify",
+		.has_arg = no_argument,
+		.val = 'V',
+	},
+	{
+		.name = "help",
+		.has_arg = no_argument,
+		.val = '?',
+	},
+	{},
+};
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: vsock_perf [--help] [--mode=client|server]\n"
+		"\t\t[--peer-cid=<cid>] [--port=<port>] [--bytes=<n>]\n"
+		"\t\t[--buf-size=<n>] [--vsk-size=<n>] [--rcvlowat=<n>]\n"
+		"\t\t[--verify]\n"
+		"\n"
+		"  Without --mode, run sender and receiver on this machine over\n"
+		"  the vsock loopback transport.\n"
+		"\n"
+		"Options:\n"
+		"  --help             This help message\n"
+		"  --mode client      Send data to --peer-cid\n"
+		"  --mode server      Receive data\n"
+		"  --peer-cid <cid>   CID of the receiver (client mode)\n"
+		"  --port <port>      Port to use (default 1234)\n"
+		"  --bytes <n>        Bytes to send (default 1GB)\n"
+		"  --buf-size <n>     Size of each read/write (default 128KB)\n"
+		"  --vsk-size <n>     SO_VM_SOCKETS_BUFFER_SIZE of both sockets\n"
+		"  --rcvlowat <n>     SO_RCVLOWAT of the receiving socket\n"
+		"  --verify           Check the received data, fail on stalls\n");
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+	enum perf_mode mode = PERF_MODE_LOOPBACK;
+	unsigned int peer_cid = VMADDR_CID_ANY;
+	int listen_fd, status;
+	pid_t pid;
+
+	for (;;) {
+		int opt = getopt_long(argc, argv, optstring, longopts, NULL);
+
+		if (opt == -1)
+			break;
+
+		switch (opt) {
+		case 'm':
+			if (strcmp(optarg, "client") == 0)
+				mode = PERF_MODE_CLIENT;
+			else if (strcmp(optarg, "server") == 0)
+				mode = PERF_MODE_SERVER;
+			else {
+				fprintf(stderr, "--mode must be \"client\" or \"server\"\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'p':
+			peer_cid = strtoul(optarg, NULL, 10);
+			break;
+		case 'P':
+			port = strtoul(optarg, NULL, 10);
+			break;
+		case 'b':
+			total_bytes = strtoull(optarg, NULL, 10);
+			break;
+		case 's':
+			buf_size = strtoul(optarg, NULL, 10);
+			break;
+		case 'v':
+			vsock_buf_size = strtoull(optarg, NULL, 10);
+			break;
+		case 'l':
+			rcvlowat = strtol(optarg, NULL, 10);
+			break;
+		case 'V':
+			verify = true;
+			break;
+		case '?':
+		default:
+			usage();
+		}
+	}
+
+	if (!buf_size)
+		usage();
+
+	signal(SIGALRM, sigalrm);
+
+	switch (mode) {
+	case PERF_MODE_CLIENT:
+		if (peer_cid == VMADDR_CID_ANY)
+			usage();
+		run_sender(peer_cid);
+		break;
+	case PERF_MODE_SERVER:
+		run_receiver(vsock_listen());
+		break;
+	case PERF_MODE_LOOPBACK:
+		listen_fd = vsock_listen();
+
+		pid = fork();
+		if (pid < 0) {
+			perror("fork");
+			return EXIT_FAILURE;
+		}
+		if (pid == 0) {
+			close(listen_fd);
+			run_sender(VMADDR_CID_LOCAL);
+			exit(EXIT_SUCCESS);
+		}
+
+		run_receiver(listen_fd);
+
+		if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+		    WEXITSTATUS(status) != EXIT_SUCCESS)
+			return EXIT_FAILURE;
+		break;
+	}
+
+	return EXIT_SUCCESS;
+}